@@ -76,7 +76,7 @@ fork_wait_bomb fork_exit_bomb ack cho_variant fib mem_eat_test
 # A list of the test programs you want compiled in from the user/progs
 # directory.
 #
-STUDENTTESTS = mutex_destroy_test cyclone multitest switzerland juggle agility_drill cvar_test paraguay racer nibbles startle join_specific_test excellent thr_exit_join beady_test rwlock_downgrade_read_test misbehave_wrap largetest
+STUDENTTESTS = mutex_destroy_test cyclone multitest switzerland juggle agility_drill cvar_test paraguay racer nibbles startle join_specific_test excellent thr_exit_join beady_test rwlock_downgrade_read_test misbehave_wrap largetest frame_churn yield_pingpong mutex_contend rwlock_readers fair_lock_test
 
 ###########################################################################
 # Data files provided by course staff to build into the RAM disk
@@ -97,7 +97,7 @@ STUDENTFILES =
 ###########################################################################
 # Object files for your thread library
 ###########################################################################
-THREAD_OBJS = malloc.o atomic_xchange.o panic.o getesp.o linked_list.o t_fork.o  mutex.o spinlock.o cond_var.o semaphore.o thread_mgmt.o rwlock.o
+THREAD_OBJS = malloc.o atomic_xchange.o atomic.o ticket_lock.o mcs_lock.o panic.o getesp.o linked_list.o t_fork.o  mutex.o spinlock.o cond_var.o semaphore.o thread_mgmt.o rwlock.o
 
 # Thread Group Library Support.
 #
@@ -110,7 +110,7 @@ THREAD_OBJS = malloc.o atomic_xchange.o panic.o getesp.o linked_list.o t_fork.o
 ###########################################################################
 # Object files for your syscall wrappers
 ###########################################################################
-SYSCALL_OBJS = set_status.o vanish.o print.o fork.o new_pages.o readline.o gettid.o yield.o sleep.o exec.o wait.o task_vanish.o misbehave.o readfile.o set_term_color.o set_cursor_pos.o deschedule.o make_runnable.o misbehave.o get_ticks.o getchar.o remove_pages.o swexn.o halt.o get_cursor_pos.o
+SYSCALL_OBJS = set_status.o vanish.o print.o fork.o new_pages.o readline.o gettid.o yield.o sleep.o exec.o wait.o task_vanish.o misbehave.o readfile.o set_term_color.o set_cursor_pos.o deschedule.o make_runnable.o misbehave.o get_ticks.o getchar.o remove_pages.o swexn.o halt.o get_cursor_pos.o set_priority.o get_idle_ticks.o futex_wait.o futex_wake.o get_zero_pool_stats.o
 
 
 ###########################################################################
@@ -130,15 +130,17 @@ AUTOSTACK_OBJS = autostack.o
 #
 KERNEL_OBJS = \
 kernel.o loader.o malloc_wrappers.o handler_install.o \
-datastructure/linked_list.o \
+datastructure/linked_list.o datastructure/avl_tree.o datastructure/pairing_heap.o datastructure/hash_table.o \
 exception/exception_handlers.o exception/exception_handler_wrappers.o exception/exception_handler_real.o\
 hardware/hardware_handler_wrappers.o hardware/keyboard.o hardware/timer.o \
-hardware/console.o \
-locks/atomic_xchange.o locks/mutex.o \
+hardware/console.o hardware/fpu.o hardware/fpu_ops.o \
+locks/atomic_xchange.o locks/atomic.o locks/mutex.o locks/futex.o \
 memory/vm_routines.o memory/memory_management.o memory/sys_memory_management.o \
+memory/tlb.o memory/region.o memory/usercopy.o memory/image_cache.o \
 process/process.o process/scheduler.o process/sys_exec.o process/sys_fork.o \
 process/sys_life_cycle.o process/do_switch.o process/enter_user_mode.o \
-process/life_cycle.o \
+process/life_cycle.o process/bitmap.o process/idle.o \
+process/wait_queue.o \
 syscall/consoleIO.o syscall/sys_consoleIO.o syscall/misc.o syscall/sys_misc.o \
 thread/thread_basic.o thread/sys_thread_management.o thread/thread_management.o \
 
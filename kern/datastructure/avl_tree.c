@@ -0,0 +1,270 @@
+/**
+* @file avl_tree.c
+*
+* @brief This file provides library functions to manipulate an AVL tree.
+*        Every operation walks a single root to leaf path, so they are all
+*        O(log n).
+*
+* @author Xianqi Zeng (xianqiz)
+* @author Tianyuan Ding (tding)
+*
+*/
+
+#include "avl_tree.h"
+#include <stddef.h>
+
+#define HEIGHT(n)   ((n) == NULL ? 0 : (n) -> height)
+#define MAX(x, y)   ((x) > (y) ? (x) : (y))
+
+/** @brief Recompute the height of a node from its children
+ *
+ *  @param n the node
+ *  @return void
+ */
+static void update_height(tree_node *n)
+{
+    n -> height = MAX(HEIGHT(n -> left), HEIGHT(n -> right)) + 1;
+}
+
+/** @brief Rotate a subtree to the right, the left child becomes the root
+ *
+ *  @param n the root of the subtree
+ *  @return the new root of the subtree
+ */
+static tree_node *rotate_right(tree_node *n)
+{
+    tree_node *l = n -> left;
+    n -> left = l -> right;
+    l -> right = n;
+    update_height(n);
+    update_height(l);
+    return l;
+}
+
+/** @brief Rotate a subtree to the left, the right child becomes the root
+ *
+ *  @param n the root of the subtree
+ *  @return the new root of the subtree
+ */
+static tree_node *rotate_left(tree_node *n)
+{
+    tree_node *r = n -> right;
+    n -> right = r -> left;
+    r -> left = n;
+    update_height(n);
+    update_height(r);
+    return r;
+}
+
+/** @brief Restore the AVL property at a node whose children are balanced
+ *
+ *  @param n the root of the subtree
+ *  @return the new root of the subtree
+ */
+static tree_node *rebalance(tree_node *n)
+{
+    update_height(n);
+    int balance = HEIGHT(n -> left) - HEIGHT(n -> right);
+    if (balance > 1)
+    {
+        if (HEIGHT(n -> left -> left) < HEIGHT(n -> left -> right))
+            n -> left = rotate_left(n -> left);
+        return rotate_right(n);
+    }
+    if (balance < -1)
+    {
+        if (HEIGHT(n -> right -> right) < HEIGHT(n -> right -> left))
+            n -> right = rotate_right(n -> right);
+        return rotate_left(n);
+    }
+    return n;
+}
+
+/** @brief Insert a node below a subtree root
+ *
+ *  @param root the root of the subtree
+ *  @param n the node to insert
+ *  @param result set to -1 if the key is already in the tree
+ *  @return the new root of the subtree
+ */
+static tree_node *insert_at(tree_node *root, tree_node *n, int *result)
+{
+    if (root == NULL) return n;
+    if (n -> key < root -> key)
+        root -> left = insert_at(root -> left, n, result);
+    else if (n -> key > root -> key)
+        root -> right = insert_at(root -> right, n, result);
+    else
+    {
+        *result = -1;
+        return root;
+    }
+    return rebalance(root);
+}
+
+/** @brief Unlink the smallest node of a subtree
+ *
+ *  @param root the root of the subtree, not NULL
+ *  @param min set to the unlinked node
+ *  @return the new root of the subtree
+ */
+static tree_node *delete_min_at(tree_node *root, tree_node **min)
+{
+    if (root -> left == NULL)
+    {
+        *min = root;
+        return root -> right;
+    }
+    root -> left = delete_min_at(root -> left, min);
+    return rebalance(root);
+}
+
+/** @brief Unlink the node with a given key from a subtree
+ *
+ *  @param root the root of the subtree
+ *  @param key the key to delete
+ *  @param deleted set to the unlinked node, untouched if not found
+ *  @return the new root of the subtree
+ */
+static tree_node *delete_at(tree_node *root, uint32_t key, tree_node **deleted)
+{
+    if (root == NULL) return NULL;
+    if (key < root -> key)
+        root -> left = delete_at(root -> left, key, deleted);
+    else if (key > root -> key)
+        root -> right = delete_at(root -> right, key, deleted);
+    else
+    {
+        *deleted = root;
+        if (root -> right == NULL) return root -> left;
+        if (root -> left == NULL) return root -> right;
+        // Replace the node by its successor
+        tree_node *successor;
+        tree_node *right = delete_min_at(root -> right, &successor);
+        successor -> left = root -> left;
+        successor -> right = right;
+        root = successor;
+    }
+    return rebalance(root);
+}
+
+/** @brief The function to initialize the tree
+ *
+ *  @param t a pointer to the tree to be initialized
+ *  @return nothing
+ */
+void tree_init(tree *t)
+{
+    if (t == NULL) return;
+    t -> root = NULL;
+    t -> size = 0;
+}
+
+/** @brief Insert a node into the tree, n -> key must be set
+ *
+ *  @param t a pointer to the tree
+ *  @param n a pointer to the node
+ *  @return 0 on success, -1 if the key is already in the tree
+ */
+int tree_insert(tree *t, tree_node *n)
+{
+    if (t == NULL || n == NULL) return -1;
+    int result = 0;
+    n -> left = n -> right = NULL;
+    n -> height = 1;
+    t -> root = insert_at(t -> root, n, &result);
+    if (result == 0) t -> size++;
+    return result;
+}
+
+/** @brief Delete the node with a given key from the tree
+ *
+ *  @param t a pointer to the tree
+ *  @param key the key to delete
+ *  @return the node that's deleted, NULL if the key is not in the tree
+ */
+tree_node *tree_delete(tree *t, uint32_t key)
+{
+    if (t == NULL) return NULL;
+    tree_node *deleted = NULL;
+    t -> root = delete_at(t -> root, key, &deleted);
+    if (deleted != NULL) t -> size--;
+    return deleted;
+}
+
+/** @brief Search for the node with a given key
+ *
+ *  @param t a pointer to the tree
+ *  @param key the key to search for
+ *  @return the node, NULL if the key is not in the tree
+ */
+tree_node *tree_search(tree *t, uint32_t key)
+{
+    if (t == NULL) return NULL;
+    tree_node *n = t -> root;
+    while (n != NULL && n -> key != key)
+        n = key < n -> key ? n -> left : n -> right;
+    return n;
+}
+
+/** @brief Search for the node with the largest key not above a given key
+ *
+ *  @param t a pointer to the tree
+ *  @param key the upper bound
+ *  @return the node, NULL if every key is larger
+ */
+tree_node *tree_floor(tree *t, uint32_t key)
+{
+    if (t == NULL) return NULL;
+    tree_node *n = t -> root;
+    tree_node *best = NULL;
+    while (n != NULL)
+    {
+        if (n -> key == key) return n;
+        if (n -> key < key)
+        {
+            best = n;
+            n = n -> right;
+        }
+        else n = n -> left;
+    }
+    return best;
+}
+
+/** @brief Get the node with the smallest key
+ *
+ *  @param t a pointer to the tree
+ *  @return the node, NULL if the tree is empty
+ */
+tree_node *tree_first(tree *t)
+{
+    if (t == NULL || t -> root == NULL) return NULL;
+    tree_node *n = t -> root;
+    while (n -> left != NULL)
+        n = n -> left;
+    return n;
+}
+
+/** @brief Search for the node with the smallest key above a given key,
+ *         used to walk the tree in order
+ *
+ *  @param t a pointer to the tree
+ *  @param key the lower bound, exclusive
+ *  @return the node, NULL if every key is smaller or equal
+ */
+tree_node *tree_next(tree *t, uint32_t key)
+{
+    if (t == NULL) return NULL;
+    tree_node *n = t -> root;
+    tree_node *best = NULL;
+    while (n != NULL)
+    {
+        if (n -> key > key)
+        {
+            best = n;
+            n = n -> left;
+        }
+        else n = n -> right;
+    }
+    return best;
+}
@@ -0,0 +1,59 @@
+/**
+* @file avl_tree.h
+*
+* @brief This is a balanced (AVL) binary search tree keyed by an unsigned
+*        integer. Like the linked list, the tree is generic: the struct
+*        that wants to be stored in a tree embeds a tree_node and uses
+*        tree_entry to get back to itself. The tree never allocates, so
+*        it can be used anywhere in the kernel.
+*
+*        Keys are unique. Besides exact lookup, the tree answers floor
+*        and successor queries, which is what an index of non-overlapping
+*        intervals keyed by their start needs.
+*
+* @author Xianqi Zeng (xianqiz)
+* @author Tianyuan Ding (tding)
+*
+*/
+
+#ifndef _AVL_TREE_H
+#define _AVL_TREE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "linked_list.h"
+
+/* tree_entry is used to get outside struct that embed this node */
+#define tree_entry(TREE_ELEM, STRUCT, MEMBER)    \
+    ((STRUCT *) ((uint8_t *) TREE_ELEM    \
+                 - offset (STRUCT, MEMBER)))
+
+
+/* Generic tree node */
+typedef struct tree_node_t
+{
+    struct tree_node_t  *left;      // Keys smaller than ours
+    struct tree_node_t  *right;     // Keys larger than ours
+    int                 height;     // Height of the subtree, leaf is 1
+    uint32_t            key;        // Sort key, unique in a tree
+} tree_node;
+
+
+// Generic tree structure
+typedef struct tree_t
+{
+    int         size;       // Number of nodes in the tree
+    tree_node   *root;      // Root node
+} tree;
+
+
+// Some generic tree functions
+void tree_init(tree *t);
+int tree_insert(tree *t, tree_node *n);
+tree_node *tree_delete(tree *t, uint32_t key);
+tree_node *tree_search(tree *t, uint32_t key);
+tree_node *tree_floor(tree *t, uint32_t key);
+tree_node *tree_first(tree *t);
+tree_node *tree_next(tree *t, uint32_t key);
+
+#endif /* _AVL_TREE_H */
@@ -0,0 +1,86 @@
+/**
+* @file hash_table.c
+*
+* @brief This file provides library functions to manipulate a hash table.
+*        Each node keeps a pointer to the pointer that points to it, so it
+*        can unlink itself without walking its bucket.
+*
+* @author Xianqi Zeng (xianqiz)
+* @author Tianyuan Ding (tding)
+*
+*/
+
+#include "hash_table.h"
+#include <stddef.h>
+
+/** @brief Initialize an empty table
+ *
+ *  @param t the table
+ *  @return void
+ */
+void hash_init(hash_table *t)
+{
+    int i;
+    t -> size = 0;
+    for (i = 0; i < HASH_BUCKETS; ++i)
+        t -> buckets[i] = NULL;
+}
+
+/** @brief Mark a node as not in any table
+ *
+ *  @param n the node
+ *  @return void
+ */
+void hash_node_init(hash_node *n)
+{
+    n -> next = NULL;
+    n -> pprev = NULL;
+}
+
+/** @brief Insert a node, its key must be set and not in the table
+ *
+ *  @param t the table
+ *  @param n the node, not in any table
+ *  @return void
+ */
+void hash_insert(hash_table *t, hash_node *n)
+{
+    hash_node **bucket = &t -> buckets[n -> key & (HASH_BUCKETS - 1)];
+    n -> next = *bucket;
+    if (*bucket != NULL)
+        (*bucket) -> pprev = &n -> next;
+    n -> pprev = bucket;
+    *bucket = n;
+    t -> size++;
+}
+
+/** @brief Remove a node
+ *
+ *  @param t the table
+ *  @param n the node, nothing happens if it is not in the table
+ *  @return void
+ */
+void hash_delete(hash_table *t, hash_node *n)
+{
+    if (n -> pprev == NULL) return;
+    *n -> pprev = n -> next;
+    if (n -> next != NULL)
+        n -> next -> pprev = n -> pprev;
+    n -> next = NULL;
+    n -> pprev = NULL;
+    t -> size--;
+}
+
+/** @brief Find the node with a key
+ *
+ *  @param t the table
+ *  @param key the key to look for
+ *  @return the node, NULL if no node has that key
+ */
+hash_node *hash_find(hash_table *t, int key)
+{
+    hash_node *n = t -> buckets[key & (HASH_BUCKETS - 1)];
+    while (n != NULL && n -> key != key)
+        n = n -> next;
+    return n;
+}
@@ -0,0 +1,60 @@
+/**
+* @file hash_table.h
+*
+* @brief This is a chained hash table keyed by an integer id. Like the
+*        other containers it is intrusive: the struct that wants to be
+*        stored embeds a hash_node and uses hash_entry to get back to
+*        itself. The bucket array is fixed, so the table never allocates
+*        and can be used with interrupts disabled.
+*
+*        Ids are handed out in increasing order, so taking the low bits
+*        spreads them evenly over the buckets. Every operation is O(1)
+*        as long as there are not many more live ids than buckets.
+*
+* @author Xianqi Zeng (xianqiz)
+* @author Tianyuan Ding (tding)
+*
+*/
+
+#ifndef _HASH_TABLE_H
+#define _HASH_TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "linked_list.h"
+
+/* Must be a power of 2 */
+#define HASH_BUCKETS 1024
+
+/* hash_entry is used to get outside struct that embed this node */
+#define hash_entry(HASH_ELEM, STRUCT, MEMBER)    \
+    ((STRUCT *) ((uint8_t *) HASH_ELEM    \
+                 - offset (STRUCT, MEMBER)))
+
+
+/* Generic hash node */
+typedef struct hash_node_t
+{
+    struct hash_node_t  *next;      // Next node in the same bucket
+    struct hash_node_t  **pprev;    // The pointer that points to us, NULL
+                                    // if we are not in a table
+    int                 key;        // The id
+} hash_node;
+
+
+// Generic hash table structure
+typedef struct hash_table_t
+{
+    int         size;                       // Number of nodes in the table
+    hash_node   *buckets[HASH_BUCKETS];     // Chains of nodes
+} hash_table;
+
+
+// Some generic hash table functions
+void hash_init(hash_table *t);
+void hash_node_init(hash_node *n);
+void hash_insert(hash_table *t, hash_node *n);
+void hash_delete(hash_table *t, hash_node *n);
+hash_node *hash_find(hash_table *t, int key);
+
+#endif /* _HASH_TABLE_H */
@@ -0,0 +1,157 @@
+/**
+* @file pairing_heap.c
+*
+* @brief This file provides library functions to manipulate a pairing
+*        heap. The children of a node form a list through their sibling
+*        pointers. Deleting a node melds its children back together in
+*        the usual two passes, done with loops instead of recursion since
+*        kernel stacks are small.
+*
+* @author Xianqi Zeng (xianqiz)
+* @author Tianyuan Ding (tding)
+*
+*/
+
+#include "pairing_heap.h"
+#include <stddef.h>
+
+/** @brief Meld two heaps, the root with the larger key becomes the first
+ *         child of the other
+ *
+ *  @param a the root of a heap, with no parent or siblings, may be NULL
+ *  @param b the root of a heap, with no parent or siblings, may be NULL
+ *  @return the root of the melded heap
+ */
+static heap_node *meld(heap_node *a, heap_node *b)
+{
+    if (a == NULL) return b;
+    if (b == NULL) return a;
+    if (b -> key < a -> key)
+    {
+        heap_node *t = a;
+        a = b;
+        b = t;
+    }
+    b -> prev = a;
+    b -> sibling = a -> child;
+    if (a -> child != NULL)
+        a -> child -> prev = b;
+    a -> child = b;
+    return a;
+}
+
+/** @brief Meld a list of siblings into one heap
+ *
+ *  The first pass melds them in pairs from left to right, the second
+ *  melds the pairs from right to left.
+ *
+ *  @param first the first sibling, may be NULL
+ *  @return the root of the resulting heap
+ */
+static heap_node *merge_pairs(heap_node *first)
+{
+    // Melded pairs, chained through sibling with the last pair first
+    heap_node *pairs = NULL;
+    while (first != NULL)
+    {
+        heap_node *a = first;
+        heap_node *b = a -> sibling;
+        first = (b == NULL) ? NULL : b -> sibling;
+
+        a -> sibling = a -> prev = NULL;
+        if (b != NULL)
+            b -> sibling = b -> prev = NULL;
+        heap_node *m = meld(a, b);
+        m -> sibling = pairs;
+        pairs = m;
+    }
+
+    heap_node *root = NULL;
+    while (pairs != NULL)
+    {
+        heap_node *next = pairs -> sibling;
+        pairs -> sibling = NULL;
+        root = meld(root, pairs);
+        pairs = next;
+    }
+    return root;
+}
+
+/** @brief Initialize an empty heap
+ *
+ *  @param h the heap
+ *  @return void
+ */
+void heap_init(heap *h)
+{
+    h -> size = 0;
+    h -> root = NULL;
+}
+
+/** @brief Insert a node, its key must be set
+ *
+ *  @param h the heap
+ *  @param n the node, not in any heap
+ *  @return void
+ */
+void heap_insert(heap *h, heap_node *n)
+{
+    n -> child = n -> sibling = n -> prev = NULL;
+    h -> root = meld(h -> root, n);
+    h -> size++;
+}
+
+/** @brief Peek at the node with the smallest key
+ *
+ *  @param h the heap
+ *  @return the node, NULL if the heap is empty
+ */
+heap_node *heap_min(heap *h)
+{
+    return h -> root;
+}
+
+/** @brief Remove the node with the smallest key
+ *
+ *  @param h the heap
+ *  @return the node, NULL if the heap is empty
+ */
+heap_node *heap_delete_min(heap *h)
+{
+    heap_node *n = h -> root;
+    if (n == NULL) return NULL;
+    h -> root = merge_pairs(n -> child);
+    n -> child = NULL;
+    h -> size--;
+    return n;
+}
+
+/** @brief Remove any node
+ *
+ *  The node is cut from its parent together with its subtree, and its
+ *  children are melded back into the heap.
+ *
+ *  @param h the heap
+ *  @param n the node, must be in the heap
+ *  @return void
+ */
+void heap_delete(heap *h, heap_node *n)
+{
+    if (n == h -> root)
+    {
+        heap_delete_min(h);
+        return;
+    }
+
+    if (n -> prev -> child == n)
+        n -> prev -> child = n -> sibling;
+    else
+        n -> prev -> sibling = n -> sibling;
+    if (n -> sibling != NULL)
+        n -> sibling -> prev = n -> prev;
+    n -> sibling = n -> prev = NULL;
+
+    h -> root = meld(h -> root, merge_pairs(n -> child));
+    n -> child = NULL;
+    h -> size--;
+}
@@ -0,0 +1,57 @@
+/**
+* @file pairing_heap.h
+*
+* @brief This is a min pairing heap keyed by an unsigned integer. Like the
+*        linked list and the AVL tree it is intrusive: the struct that
+*        wants to be stored in a heap embeds a heap_node and uses
+*        heap_entry to get back to itself. The heap never allocates, so
+*        it can be used from interrupt handlers.
+*
+*        Insert and finding the minimum are O(1), deleting the minimum or
+*        any other node is O(log n) amortized. Keys need not be unique.
+*
+* @author Xianqi Zeng (xianqiz)
+* @author Tianyuan Ding (tding)
+*
+*/
+
+#ifndef _PAIRING_HEAP_H
+#define _PAIRING_HEAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "linked_list.h"
+
+/* heap_entry is used to get outside struct that embed this node */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)    \
+    ((STRUCT *) ((uint8_t *) HEAP_ELEM    \
+                 - offset (STRUCT, MEMBER)))
+
+
+/* Generic heap node */
+typedef struct heap_node_t
+{
+    struct heap_node_t  *child;     // First child, keys not smaller
+    struct heap_node_t  *sibling;   // Next child of our parent
+    struct heap_node_t  *prev;      // Previous sibling, or the parent
+                                    // if we are the first child
+    uint32_t            key;        // Sort key
+} heap_node;
+
+
+// Generic heap structure
+typedef struct heap_t
+{
+    int         size;       // Number of nodes in the heap
+    heap_node   *root;      // Node with the smallest key
+} heap;
+
+
+// Some generic heap functions
+void heap_init(heap *h);
+void heap_insert(heap *h, heap_node *n);
+heap_node *heap_min(heap *h);
+heap_node *heap_delete_min(heap *h);
+void heap_delete(heap *h, heap_node *n);
+
+#endif /* _PAIRING_HEAP_H */
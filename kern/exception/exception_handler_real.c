@@ -18,13 +18,84 @@
 #include <stdio.h>
 #include "process/enter_user_mode.h"
 #include <malloc.h>
+#include <ureg.h>
+#include "memory/vm_routines.h"
+#include "process/scheduler.h"
+#include "thread/thread_basic.h"
+#include "hardware/fpu.h"
+#include "locks/mutex_type.h"
+#include <x86/asm.h>
 
 extern void sys_vanish(void);
 extern void sys_set_status();
 
+/** @brief Free every other thread of the current process
+ *
+ *  A peer that holds a kernel mutex is in the middle of a critical
+ *  section, so it runs until it has released all of them. Then every
+ *  peer is taken out of all queues at once, before any of them can run
+ *  and take a mutex again, and only then freed.
+ *
+ *  @return void
+ **/
+static void reap_peers(void)
+{
+    PCB *pcb = current_thread -> pcb;
+    list doomed;
+    node *n, *next;
+    list_init(&doomed);
+
+    while (1)
+    {
+        disable_interrupts();
+        TCB *busy = NULL;
+        for (n = list_begin(&pcb -> threads); n != NULL; n = n -> next)
+        {
+            TCB *tcb = list_entry(n, TCB, peer_threads_node);
+            if (tcb != current_thread && tcb -> held_mutexes.length != 0)
+            {
+                busy = tcb;
+                break;
+            }
+        }
+        if (busy == NULL) break;
+        schedule(busy -> tid);
+    }
+
+    for (n = list_begin(&pcb -> threads); n != NULL; n = next)
+    {
+        next = n -> next;
+        TCB *tcb = list_entry(n, TCB, peer_threads_node);
+        if (tcb == current_thread) continue;
+        list_delete(&pcb -> threads, n);
+        mutex_cancel_wait(tcb);
+        wq_remove(tcb);
+        runq_delete(tcb);
+        sleep_cancel(tcb);
+        thr_unregister(tcb);
+        list_insert_last(&doomed, n);
+    }
+    enable_interrupts();
+
+    // Nobody can reach them any more, malloc may block now
+    while ((n = list_delete_first(&doomed)) != NULL)
+    {
+        TCB *tcb = list_entry(n, TCB, peer_threads_node);
+        fpu_release(tcb);
+        sfree(tcb -> stack_base, tcb -> stack_size);
+        free(tcb);
+    }
+}
+
 void get_real_handler(ureg_t* cur_ureg)
 {
     cur_ureg->cr2 = get_cr2();
+
+    // Faults the kernel can fix (copy-on-write) go straight back
+    if (cur_ureg->cause == SWEXN_CAUSE_PAGEFAULT &&
+        resolve_page_fault(cur_ureg->cr2, cur_ureg->error_code) == 0)
+        return;
+
     lprintf("getting real handler.........print ureg info that I created:");
     lprintf("eip:%x",(unsigned int)cur_ureg->eip);
     // MAGIC_BREAK;
@@ -34,25 +105,7 @@ void get_real_handler(ureg_t* cur_ureg)
         sys_set_status(-2);
 
         /* reap peer threads first before vanishing the thread itself*/
-        PCB *current_pcb = current_thread -> pcb;
-        // display to the console by print()....
-        list threads = current_pcb -> threads;
-        node *n;
-        // printf("Vanish! CPU registers info: cr2: %p, eip: %p, esp: %p, 
-        //         ebp: %p", get_cr2(),get_eip(),get_esp(),get_ebp());
-        for (n = list_begin(&threads); n != NULL; n = n -> next)
-        {
-            TCB *tcb = list_entry(n, TCB, peer_threads_node);
-            // We only reap threads that is not the current thread
-            if (tcb -> tid != current_thread -> tid)
-            {
-                list_delete(&threads, n);
-                list_delete(&blocked_queue, n);
-                list_delete(&runnable_queue, n);
-                sfree(tcb -> stack_base, tcb -> stack_size);
-                free(tcb);
-            }
-        }
+        reap_peers();
         sys_vanish();
     }
     //if installed, try to call the real handler;
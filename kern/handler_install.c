@@ -10,6 +10,7 @@
 
 #include <syscall_int.h>
 #include "syscall.h"
+#include <syscall_ext.h>
 #include <stdio.h>
 #include <seg.h>
 #include <asm.h>
@@ -26,9 +27,6 @@
 
 extern void PF();
 
-/* Configure the timer to generate interrupts every 10 milliseconds. */
-#define FREQ 100
-
 int handler_install(void (*tickback)(unsigned int))
 {
     /* Initialize the fault handlers */
@@ -40,7 +38,7 @@ int handler_install(void (*tickback)(unsigned int))
     // _handler_install(SWEXN_CAUSE_OVERFLOW, OF);            //no error code
     // _handler_install(SWEXN_CAUSE_BOUNDCHECK, BR);          //no error code
     // _handler_install(SWEXN_CAUSE_OPCODE, UD);              //no error code
-    // _handler_install(SWEXN_CAUSE_NOFPU, NM);               //no error code
+    _handler_install(SWEXN_CAUSE_NOFPU, NM);      //no error code
 
     // _handler_install(SWEXN_CAUSE_SEGFAULT, NP);            //error code: yes
     // _handler_install(SWEXN_CAUSE_STACKFAULT, SS);          //error code: yes
@@ -60,8 +58,8 @@ int handler_install(void (*tickback)(unsigned int))
 
     /* Initialize the hardware handlers */
 
-    /* Initialize the timer */
-    uint32_t period = TIMER_RATE / FREQ;
+    /* Initialize the timer, one interrupt per tick */
+    uint32_t period = TIMER_TICK_COUNT;
     outb(TIMER_MODE_IO_PORT, TIMER_SQUARE_WAVE);
     outb(TIMER_PERIOD_IO_PORT, period & 0xFF);
     outb(TIMER_PERIOD_IO_PORT, (period >> 8) & 0xFF);
@@ -99,6 +97,11 @@ int handler_install(void (*tickback)(unsigned int))
     _handler_install(SET_TERM_COLOR_INT, (void *)set_term_color);
     _handler_install(GET_CURSOR_POS_INT, (void *)get_cursor_pos);
     _handler_install(SET_CURSOR_POS_INT, (void *)set_cursor_pos);
+    _handler_install(SET_PRIORITY_INT, (void *)set_priority);
+    _handler_install(GET_IDLE_TICKS_INT, (void *)get_idle_ticks);
+    _handler_install(FUTEX_WAIT_INT, (void *)futex_wait);
+    _handler_install(FUTEX_WAKE_INT, (void *)futex_wake);
+    _handler_install(GET_ZERO_POOL_STATS_INT, (void *)get_zero_pool_stats);
     return 0;
 }
 
@@ -0,0 +1,168 @@
+/** @file fpu.c
+ *
+ *  @brief This file switches the floating point state lazily.
+ *
+ *  The registers hold the state of one thread, fpu_owner. Switching to
+ *  any other thread sets CR0.TS, so its first FPU or SSE instruction
+ *  raises #NM. Only then the owner's state is saved to its area and the
+ *  new thread's is loaded. A thread that never touches the FPU has no
+ *  save area and costs nothing on a switch but the TS bit.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#include "control_block.h"
+#include "fpu.h"
+#include "cr.h"
+#include <malloc.h>
+#include <string.h>
+#include <x86/asm.h>
+#include <eflags.h>
+#include "simics.h"
+
+extern void sys_vanish(void);
+extern void sys_set_status(int status);
+
+// Where MXCSR and the XMM registers sit in an fxsave area
+#define FXSAVE_MXCSR    24
+#define FXSAVE_REGS     32
+#define FXSAVE_REGS_END 288
+
+// MXCSR after reset, every SSE exception masked, round to nearest
+#define MXCSR_DEFAULT   0x1f80
+
+// The thread whose state is in the registers, NULL if nobody's is
+static TCB *fpu_owner;
+
+// The state a thread finds on its first FPU or SSE instruction
+static char fpu_clean_state[FPU_STATE_SIZE]
+    __attribute__((aligned(FPU_STATE_ALIGN)));
+
+/** @brief Enable the FPU and SSE, trapping on first use
+ *
+ *  The boot code sets CR0.EM, which makes every FPU instruction fault
+ *  for good and SSE instructions undefined.
+ *
+ *  @return void
+ **/
+void fpu_init()
+{
+    fpu_owner = NULL;
+    set_cr0((get_cr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+    set_cr4(get_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+
+    // fninit leaves MXCSR and the XMM registers alone, so the clean
+    // state sets them explicitly
+    fpu_reset();
+    fpu_save(fpu_clean_state);
+    memset(fpu_clean_state + FXSAVE_REGS, 0, FXSAVE_REGS_END - FXSAVE_REGS);
+    *(uint32_t *)(fpu_clean_state + FXSAVE_MXCSR) = MXCSR_DEFAULT;
+    set_cr0(get_cr0() | CR0_TS);
+}
+
+/** @brief Arm the trap for the thread about to run, called on every
+ *         context switch
+ *
+ *  CR0 is only written when TS has to change.
+ *
+ *  @param next the thread about to run
+ *  @return void
+ **/
+void fpu_switch(TCB *next)
+{
+    uint32_t cr0 = get_cr0();
+    if (next == fpu_owner)
+    {
+        if (cr0 & CR0_TS) fpu_clts();
+    }
+    else if (!(cr0 & CR0_TS))
+    {
+        set_cr0(cr0 | CR0_TS);
+    }
+}
+
+/** @brief The #NM handler, give the registers to the current thread
+ *
+ *  @return void
+ **/
+void fpu_trap()
+{
+    // Allocate first, malloc may block
+    int fresh = 0;
+    if (current_thread -> fpu_state == NULL)
+    {
+        void *area = smemalign(FPU_STATE_ALIGN, FPU_STATE_SIZE);
+        if (area == NULL)
+        {
+            lprintf("no memory for the fpu state of %d", current_thread -> tid);
+            sys_set_status(-2);
+            sys_vanish();
+        }
+        current_thread -> fpu_state = area;
+        fresh = 1;
+    }
+
+    // A switch in the middle would set TS again under our feet
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    fpu_clts();
+    if (fpu_owner != current_thread)
+    {
+        if (fpu_owner != NULL)
+            fpu_save(fpu_owner -> fpu_state);
+        if (fresh)
+            fpu_restore(fpu_clean_state);
+        else
+            fpu_restore(current_thread -> fpu_state);
+        fpu_owner = current_thread;
+    }
+    set_eflags(eflags);
+}
+
+/** @brief Give a forked thread a copy of the parent's state
+ *
+ *  @param parent the forking thread, which is running
+ *  @param child the new thread
+ *  @return void
+ **/
+void fpu_fork(TCB *parent, TCB *child)
+{
+    child -> fpu_state = NULL;
+    if (parent -> fpu_state == NULL) return;
+
+    void *area = smemalign(FPU_STATE_ALIGN, FPU_STATE_SIZE);
+    if (area == NULL) return;     // the child starts with a clean FPU
+
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    if (fpu_owner == parent)
+        fpu_save(area);
+    else
+        memcpy(area, parent -> fpu_state, FPU_STATE_SIZE);
+    child -> fpu_state = area;
+    set_eflags(eflags);
+}
+
+/** @brief Drop the state of a thread that exits, is reaped or execs
+ *
+ *  @param tcb the thread
+ *  @return void
+ **/
+void fpu_release(TCB *tcb)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    if (fpu_owner == tcb)
+        fpu_owner = NULL;
+    // The next instruction of a running thread must trap again
+    if (tcb == current_thread)
+        set_cr0(get_cr0() | CR0_TS);
+    void *area = tcb -> fpu_state;
+    tcb -> fpu_state = NULL;
+    set_eflags(eflags);
+
+    if (area != NULL)
+        sfree(area, FPU_STATE_SIZE);
+}
@@ -0,0 +1,35 @@
+/** @file fpu.h
+ *
+ *  @brief Lazy switching of the x87/SSE register state between threads.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#ifndef _FPU_H
+#define _FPU_H
+
+#include "control_block.h"
+
+/* fxsave writes 512 bytes to a 16 byte aligned area */
+#define FPU_STATE_SIZE  512
+#define FPU_STATE_ALIGN 16
+
+void fpu_init();
+
+void fpu_switch(TCB *next);
+
+void fpu_trap();
+
+void fpu_fork(TCB *parent, TCB *child);
+
+void fpu_release(TCB *tcb);
+
+/* In fpu_ops.S */
+void fpu_save(void *area);
+void fpu_restore(void *area);
+void fpu_reset();
+void fpu_clts();
+
+#endif /* _FPU_H */
@@ -25,6 +25,7 @@
 #include "keyboard.h"
 #include "console.h"
 #include "control_block.h"
+#include "process/scheduler.h"
 
 #define BUF_LEN 512  // Default buffer length, to hold 512 scan codes in a queue
 
@@ -61,9 +62,6 @@ void keyboard_handler()
     uint8_t scancode = inb(KEYBOARD_PORT);
     kh_type aug_char = process_scancode(scancode);
     char real_char;
-    TCB* next_readline_thread = NULL;
-    node *n;
-    int found_flag = 0;
     /* When aug_char has data, go and extract it's char value */
     if (!KH_HASDATA(aug_char) || !KH_ISMAKE(aug_char))
     {
@@ -81,20 +79,7 @@ void keyboard_handler()
         {
             lprintf("this is an enter");
             // MAGIC_BREAK;
-            for (n = list_begin(&blocked_queue); n != NULL; n = n -> next)
-            {
-                next_readline_thread = list_entry(n, TCB, thread_list_node);
-                if (next_readline_thread -> state == THREAD_READLINE)
-                {
-                    next_readline_thread -> state = THREAD_RUNNABLE;
-                    list_delete(&blocked_queue, &next_readline_thread->thread_list_node);
-                    list_insert_last(&runnable_queue, &next_readline_thread->thread_list_node);
-                    lprintf("there is one waiting readline");
-                    found_flag = 1;
-                    break;
-                }
-            }
-            if (!found_flag) 
+            if (wq_wake_one(&console_readers) == NULL)
             {
                 lprintf("not found!");
                 putbyte(real_char);
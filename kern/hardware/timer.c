@@ -13,14 +13,18 @@
 #include "simics.h"
 #include "interrupt_defines.h"
 #include "timer.h"
+#include <stdint.h>
 
 static void (*callback)(unsigned int);
 
 unsigned int numTicks = 0;  // Number of total ticks
 
+// Ticks that pass between two interrupts, more than one while idle
+static unsigned int ticks_per_interrupt = 1;
+
 int timer_handler()
 {
-    numTicks++;
+    numTicks += ticks_per_interrupt;
     outb(INT_CTL_PORT, INT_ACK_CURRENT);  // Send ack back
     if (callback != NULL)
         (*callback)(numTicks);
@@ -36,4 +40,17 @@ void setup_timer(void (*tickback)(unsigned int))
 unsigned int sys_get_ticks()
 {
     return numTicks;
+}
+
+void timer_set_interval(unsigned int ticks)
+{
+    if (ticks < 1) ticks = 1;
+    if (ticks > TIMER_MAX_TICKS) ticks = TIMER_MAX_TICKS;
+    if (ticks == ticks_per_interrupt) return;
+
+    uint32_t period = ticks * TIMER_TICK_COUNT;
+    outb(TIMER_MODE_IO_PORT, TIMER_SQUARE_WAVE);
+    outb(TIMER_PERIOD_IO_PORT, period & 0xFF);
+    outb(TIMER_PERIOD_IO_PORT, (period >> 8) & 0xFF);
+    ticks_per_interrupt = ticks;
 }
\ No newline at end of file
@@ -9,6 +9,15 @@
 #ifndef __timer_h_
 #define __timer_h_
 
+#include <timer_defines.h>
+
+/* The timer interrupts every 10 milliseconds, that is one tick */
+#define TIMER_FREQ 100
+#define TIMER_TICK_COUNT (TIMER_RATE / TIMER_FREQ)
+
+/* The longest interval the 16 bit counter can be programmed for */
+#define TIMER_MAX_TICKS (0xffff / TIMER_TICK_COUNT)
+
 /** @brief The timer handler
  *	
  *	It calls the callback function, if it's not NULL, with number of total ticks
@@ -29,4 +38,15 @@ void setup_timer(void (*tickback)(unsigned int));
  *  @return void
  **/
 unsigned int sys_get_ticks();
+
+/** @brief Make the timer interrupt once every few ticks instead of every
+ *         tick, used while the CPU idles
+ *
+ *  Should be called right after a timer interrupt, since reprogramming
+ *  restarts the current interval.
+ *
+ *  @param ticks ticks per interrupt, clamped to [1, TIMER_MAX_TICKS]
+ *  @return void
+ **/
+void timer_set_interval(unsigned int ticks);
 #endif
\ No newline at end of file
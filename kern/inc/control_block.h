@@ -14,9 +14,13 @@
 
 #include "ureg.h"
 #include "datastructure/linked_list.h"
+#include "datastructure/pairing_heap.h"
+#include "datastructure/hash_table.h"
 #include <elf/elf_410.h>
 #include "locks/mutex_type.h"
+#include "process/wait_queue.h"
 #include "mem_internals.h"
+#include <syscall_ext.h>
 
 // The thread is exited, set by vanish()
 #define THREAD_EXIT -2
@@ -39,9 +43,19 @@
 // The thread is just created, has never run
 #define THREAD_INIT 4
 
+// Run queue levels, user priorities and one below them for the idle thread
+#define NUM_PRIORITIES 32
+#define IDLE_PRIORITY (NUM_PRIORITIES - 1)
+
 // The thread is calling readline and should block
 #define THREAD_READLINE 5
 
+// The thread waits in the waiting queue of a kernel mutex
+#define THREAD_MUTEX 6
+
+// The thread waits on a user word in futex_wait
+#define THREAD_FUTEX 7
+
 // The process is in exit state, waiting for parent to reap it
 #define PROCESS_EXIT -2
 #define PROCESS_BLOCKED -1
@@ -74,14 +88,23 @@ typedef struct PCB_t
     // The inner node that is used for all process queue
     node all_processes_node;
 
+    // The inner node of pid_table, keyed by pid
+    hash_node pid_node;
+
     // The page directory pointer for this process
     uint32_t *PD;
 
     // The number of live children that are created by this process via fork
     int children_count;
 
-    //A list of va_info
-    list va;
+    //A tree of va_info, the user memory regions sorted by base address
+    tree va;
+
+    //Layout of the program image, for loading its pages on demand
+    IMAGE_INFO image;
+
+    // Threads of this process blocked in wait until a child exits
+    wait_queue exit_waiters;
 
 } PCB;
 
@@ -111,11 +134,25 @@ typedef struct TCB_t
     // Thread state, can be several as listed above
     int state;
 
-    // The thread sleeps at this time point
-    unsigned int start_ticks;
+    // The inner node that belongs to the sleep queue, keyed by the tick
+    // this thread should wake up at
+    heap_node sleep_node;
+
+    // Scheduling priority, PRIORITY_HIGHEST runs first. It can be higher
+    // than base_priority, the one set by set_priority, while a thread
+    // waits for a mutex this thread holds
+    int priority;
+    int base_priority;
+
+    // The kernel mutexes this thread holds, and the one it waits for
+    list held_mutexes;
+    mutex_t *blocked_on;
+
+    // The run queue level this thread is queued at, -1 if not queued
+    int runq_level;
 
-    // The number of ticks that this thread should sleep
-    unsigned int duration;
+    // Ticks left of the current time slice, kept while blocked
+    int slice_left;
 
     // Thread kernel stack base pointer
     void *stack_base;
@@ -130,9 +167,18 @@ typedef struct TCB_t
     // this process via threadfork
     node peer_threads_node;
 
-    // The inner node that belongs to either runnable queue or blocked queue
+    // The inner node that belongs to either a run queue or a wait queue
     node thread_list_node;
 
+    // The wait queue this thread is blocked in, NULL if none
+    wait_queue *waiting_in;
+
+    // Virtual address of the word this thread waits on in futex_wait
+    uint32_t futex_key;
+
+    // Saved FPU and SSE registers, NULL until the first FPU instruction
+    void *fpu_state;
+
     // The inner node that belongs to the wait queue that waits for a mutex
     node mutex_waiting_queue_node;
 
@@ -142,6 +188,9 @@ typedef struct TCB_t
     // The swexn handler information
     swexninfo swexn_info;
 
+    // The inner node of tid_table, keyed by tid
+    hash_node tid_node;
+
 } TCB;
 
 
@@ -155,14 +204,24 @@ uint32_t next_tid;
 
 uint32_t next_pid;
 
-// Thread that has state THREAD_BLOCKED, THREAD_SLEEPING,
-// THREAD_WAITING and THREAD_READLINE should go into this queue
-mutex_t blocked_queue_lock;
-list blocked_queue;
+// Thread that has state THREAD_BLOCKED waits here for make_runnable,
+// thread that has state THREAD_READLINE waits here for a line of input.
+// Thread that has state THREAD_WAITING waits in exit_waiters of its PCB
+wait_queue descheduled_threads;
+wait_queue console_readers;
+
+// Thread that has state THREAD_SLEEPING goes into this heap, ordered by
+// wake up tick, which the timer interrupt checks on every tick
+heap sleep_queue;
 
-// Thread that has state THREAD_RUNNABLE or THREAD_INIT should go in this queue
+// Thread that has state THREAD_RUNNABLE or THREAD_INIT should go in one
+// of these queues, the one of its priority. Bit i of runq_bitmap is set
+// if and only if run_queues[i] is not empty, so the next thread to run is
+// found with a single bit scan
 mutex_t runnable_queue_lock;
-list runnable_queue;
+list run_queues[NUM_PRIORITIES];
+uint32_t runq_bitmap;
+int runq_length;
 
 // Lock that is used for atomicity of deschedule and make_runnable
 mutex_t deschedule_lock;
@@ -170,12 +229,31 @@ mutex_t deschedule_lock;
 mutex_t process_queue_lock;
 list process_queue;
 
+// Live threads by tid and live processes by pid. A thread leaves
+// tid_table when it vanishes, a process leaves pid_table when its last
+// thread vanishes
+hash_table tid_table;
+hash_table pid_table;
+
 // print lock
 mutex_t print_lock;
 
 // The number of free physical 
 int free_frame_num;
 
+// Zeroed frames taken from the pre-zeroed pool, and taken dirty and
+// zeroed on the spot because the pool was empty
+unsigned int zero_pool_hits;
+unsigned int zero_pool_misses;
+
+// Ticks spent running the idle thread
+unsigned int idle_ticks;
+
+// Context switches between threads of the same process, which keep the
+// page directory, and between processes
+unsigned int switches_same_space;
+unsigned int switches_cross_space;
+
 int total_num; //total number of chars in a line (to prevent deleting 410 shell phrases)
 
 #endif /* _CONTROL_B_H */
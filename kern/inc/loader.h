@@ -16,6 +16,8 @@
 
 int getbytes( const char *filename, int offset, int size, char *buf );
 
+int find_exec_entry( const char *filename );
+
 /*
  * Declare your loader prototypes here.
  */
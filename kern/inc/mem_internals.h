@@ -13,6 +13,7 @@
 #define _MEM_INTERNALS_H
 #include <stdint.h>
 #include "datastructure/linked_list.h"
+#include "datastructure/avl_tree.h"
 
 #define PT_SIZE 1024
 #define PD_SIZE 1024
@@ -26,15 +27,44 @@ typedef struct kernel_frame
 } KF;
 
 
+// Kinds of user memory regions
+#define REGION_NEW_PAGES 0		// created by new_pages, can be removed
+#define REGION_ELF		 1		// text, rodata, data and bss of the program
+#define REGION_STACK	 2		// initial user stack
+
 typedef struct addr_info
 {
 	uint32_t virtual_addr;
 	//multiple of page size, specifying the length 
 	//of allocated area from the virtual address as base
 	uint32_t len;
-	node va_node; 
+	//one of the REGION_ kinds above
+	int type;
+	//node in the pcb's region tree, keyed by virtual_addr
+	tree_node va_node; 
 } VA_INFO;
 
 
+// Sections of the program image that are backed by the executable
+#define IMAGE_TEXT		 0
+#define IMAGE_RODATA	 1
+#define IMAGE_DATA		 2
+#define IMAGE_SECTIONS	 3
+
+// Where the pages of the program image come from, filled in by exec so
+// that file backed pages can be loaded when they are first touched
+typedef struct image_info
+{
+	// index of the executable in the exec2obj table of contents
+	int entry;
+	// the executable inside the exec2obj image, never freed
+	const char *bytes;
+	// virtual address, offset in the executable and length of each section
+	uint32_t start[IMAGE_SECTIONS];
+	uint32_t offset[IMAGE_SECTIONS];
+	uint32_t len[IMAGE_SECTIONS];
+} IMAGE_INFO;
+
+
 
 #endif /* _MEM_INTERNALS_H */
\ No newline at end of file
@@ -27,6 +27,7 @@
 #include "handler_install.h"
 #include "memory/vm_routines.h"
 #include "process/process.h"
+#include "hardware/fpu.h"
 #include "thread/thread_basic.h"
 
 
@@ -58,6 +59,9 @@ int kernel_main(mbinfo_t *mbinfo, int argc, char **argv, char **envp)
     // Initialize virtual memory system and enable paging
     mm_init();
 
+    // Let user threads use the FPU, switched lazily
+    fpu_init();
+
     // Initialize process management system
     process_init();
 
@@ -67,7 +71,7 @@ int kernel_main(mbinfo_t *mbinfo, int argc, char **argv, char **envp)
     enable_interrupts();
 
     lprintf("Hello from a brand new kernel!");
-    process_create("idle", 0);   // we hang idle
+    idle_create();   // the idle thread waits in the run queue
 
 
 
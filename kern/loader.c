@@ -24,6 +24,29 @@
 
 
 
+/**
+ * Finds an executable in the exec2obj table of contents.
+ *
+ * @param filename   the name of the file
+ *
+ * @return the index of the file in the table of contents; -1 if there
+ *         is no such file
+ */
+
+int find_exec_entry( const char *filename )
+{
+    int i = 0;
+    for (i = 0; i < exec2obj_userapp_count; i++)
+    {
+        if (!strcmp(exec2obj_userapp_TOC[i].execname , filename))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
 /**
  * Copies data from a file into a buffer.
  *
@@ -37,18 +60,13 @@
 
 int getbytes( const char *filename, int offset, int size, char *buf )
 {
-
-    int i = 0;
-    for (i = 0; i < exec2obj_userapp_count; i++)
-    {   
-        // If we find this filename
-        if (!strcmp(exec2obj_userapp_TOC[i].execname , filename))
-        {
-            memcpy(buf, (void *)exec2obj_userapp_TOC[i].execbytes + offset, size);
-            return size;
-        }
+    int entry = find_exec_entry(filename);
+    if (entry < 0)
+    {
+        return -1;
     }
-    return -1;
+    memcpy(buf, (void *)exec2obj_userapp_TOC[entry].execbytes + offset, size);
+    return size;
 }
 
 
@@ -0,0 +1,167 @@
+/**
+* @file futex.c
+*
+* @brief  Futex wait and wake. Waiters sit in a fixed table of wait queues
+*         hashed by the process and the virtual address of the word they
+*         wait on, and remember that address so a wake up can skip the
+*         waiters of other words in the same bucket.
+*
+*         No memory is shared between processes, so the process and the
+*         virtual address name a word for good, even when fork and
+*         copy-on-write move it to another frame. Checking the word and
+*         queueing happen with interrupts disabled, so a wake up between
+*         the two cannot get lost.
+*
+* @author Xianqi Zeng (xianqiz)
+* @author Tianyuan Ding (tding)
+* @bugs No known bugs
+*/
+#include "futex.h"
+#include "control_block.h"
+#include "process/wait_queue.h"
+#include "memory/vm_routines.h"
+#include <common_kern.h>
+#include <page.h>
+#include <stddef.h>
+#include <x86/asm.h>
+#include <eflags.h>
+
+/* Must be a power of 2 */
+#define FUTEX_BUCKETS   64
+
+// Words are 4 byte aligned, so the low two bits carry no information
+#define FUTEX_HASH(pcb, va) \
+    ((((va) >> 2) ^ (uint32_t)(pcb) -> pid) & (FUTEX_BUCKETS - 1))
+
+static wait_queue futex_queues[FUTEX_BUCKETS];
+
+/** @brief Initialize the futex table
+ *
+ *  @return void
+ **/
+void futex_init()
+{
+    int i;
+    for (i = 0; i < FUTEX_BUCKETS; ++i)
+        wq_init(&futex_queues[i]);
+}
+
+/** @brief Check a user word of the current process, faulting its page
+ *         in first if needed
+ *
+ *  Must be called with interrupts disabled, the page stays mapped until
+ *  they are enabled again.
+ *
+ *  @param addr the user word
+ *  @return 0 if the word can be read without a fault, -1 if addr is not
+ *          an aligned writable word in one of the regions of the process
+ **/
+static int futex_check(int *addr)
+{
+    uint32_t va = (uint32_t)addr;
+    uint32_t *pd = current_thread -> pcb -> PD;
+
+    if (va < USER_MEM_START || (va & (sizeof(int) - 1)) != 0)
+        return -1;
+
+    while (1)
+    {
+        uint32_t pde = pd[VA_PD_IND(va)];
+        if (!(pde & PTE_PRESENT)) return -1;
+        uint32_t pte = ((uint32_t *)DEFLAG_ADDR(pde))[VA_PT_IND(va)];
+
+        // A copy-on-write page is writable as far as the user can tell
+        if ((pte & (PTE_PRESENT | PTE_USER)) == (PTE_PRESENT | PTE_USER) &&
+            (pte & (PTE_RW | PTE_COW)))
+            return 0;
+
+        // Bring in a lazy page
+        if (!IS_LAZY_PTE(pte) || !(pte & PTE_RW))
+            return -1;
+        if (resolve_page_fault(va, PF_ERR_WRITE) < 0)
+            return -1;
+    }
+}
+
+/** @brief Block until woken up by futex_wake, if *addr == expected
+ *
+ *  @param addr the user word, 4 byte aligned and writable
+ *  @param expected the value the caller last saw in the word
+ *  @return 0 once woken up or right away if the word has changed, -1 if
+ *          addr is not a valid word
+ **/
+int sys_futex_wait(int *addr, int expected)
+{
+    PCB *pcb = current_thread -> pcb;
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+
+    if (futex_check(addr) < 0)
+    {
+        set_eflags(eflags);
+        return -1;
+    }
+    // The page is present, reading it cannot fault
+    if (*addr != expected)
+    {
+        set_eflags(eflags);
+        return 0;
+    }
+    current_thread -> futex_key = (uint32_t)addr;
+    wq_wait(&futex_queues[FUTEX_HASH(pcb, (uint32_t)addr)], THREAD_FUTEX);
+
+    set_eflags(eflags);
+    return 0;
+}
+
+/** @brief Wake up to count threads waiting on a word, longest waiting
+ *         first
+ *
+ *  @param addr the user word, 4 byte aligned and writable
+ *  @param count the most threads to wake
+ *  @return the number of threads woken up, -1 if addr is not a valid
+ *          word or count is negative
+ **/
+int sys_futex_wake(int *addr, int count)
+{
+    PCB *pcb = current_thread -> pcb;
+    uint32_t key = (uint32_t)addr;
+    int woken = 0;
+
+    if (count < 0) return -1;
+
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    if (futex_check(addr) < 0)
+    {
+        set_eflags(eflags);
+        return -1;
+    }
+
+    // Find the youngest of the count oldest waiters of the word
+    wait_queue *wq = &futex_queues[FUTEX_HASH(pcb, key)];
+    node *n, *last = NULL;
+    for (n = list_begin(&wq -> waiters); n != NULL && woken < count;
+         n = n -> next)
+    {
+        TCB *tcb = list_entry(n, TCB, thread_list_node);
+        if (tcb -> futex_key == key && tcb -> pcb == pcb)
+        {
+            last = n;
+            woken++;
+        }
+    }
+
+    // A woken thread goes to the head of its run queue, so wake them
+    // youngest first to leave the oldest in front
+    for (n = last; n != NULL; )
+    {
+        node *prev = n -> prev;
+        TCB *tcb = list_entry(n, TCB, thread_list_node);
+        if (tcb -> futex_key == key && tcb -> pcb == pcb)
+            wq_wake(tcb);
+        n = prev;
+    }
+    set_eflags(eflags);
+    return woken;
+}
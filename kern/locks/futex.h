@@ -0,0 +1,23 @@
+/**
+ * @file futex.h
+ *
+ * @brief Wait and wake on a user word. A thread blocks only if the word
+ *        still holds the value it expects, and waiters are found again
+ *        through their process and the virtual address of the word, so
+ *        every thread of the process meets in the same queue.
+ *
+ * @author Xianqi Zeng (xianqiz)
+ * @author Tianyuan Ding (tding)
+ *
+ */
+
+#ifndef _FUTEX_H
+#define _FUTEX_H
+
+void futex_init();
+
+int sys_futex_wait(int *addr, int expected);
+
+int sys_futex_wake(int *addr, int count);
+
+#endif /* _FUTEX_H */
@@ -1,11 +1,20 @@
 /**
 * @file mutex.c
 *
-* @brief  The mutex is implemented by a spinlock. Note that we didn't ensure 
-*         bounded waiting because otherwise we have to add additional queue 
-*         and make use of more syscall like deschedule and make_runnable just 
-*         like what cond_var does, which lead to more memory cost and system 
-*         speed overhead. A spinlock is simple enough to suffice.
+* @brief  The kernel mutex. A thread that finds the mutex locked blocks in
+*         its FIFO waiting queue instead of spinning. Unlocking hands the
+*         mutex directly to the first waiter, so a thread that comes later
+*         cannot grab it first, and a waiter is served after at most as
+*         many critical sections as there were waiters ahead of it.
+*
+*         While a thread waits, the holder runs at the waiter's priority
+*         if that is higher, and so does the holder of the mutex that the
+*         holder itself waits for, and so on. A thread gets back to its
+*         own priority, or to the highest priority of the waiters of the
+*         mutexes it still holds, when it unlocks.
+*
+*         Everything happens with interrupts disabled, which is enough on
+*         the single processor that runs threads.
 *
 * @author Xianqi Zeng (xianqiz)
 * @author Tianyuan Ding (tding)
@@ -14,10 +23,11 @@
 #include <syscall.h>
 #include "mutex_type.h"
 #include "control_block.h"
-#include "atomic_xchange.h"
 #include "process/scheduler.h"
 #include "simics.h"
 #include <stddef.h>
+#include <x86/asm.h>
+#include <eflags.h>
 
 /** @brief The function to initialize a mutex, which is unlocked initially
  *
@@ -28,6 +38,7 @@ int mutex_init(mutex_t *mp)
 {
     mp -> status = MUTEX_UNLOCKED;
     mp -> tid = -1;
+    mp -> owner = NULL;
     list_init(&mp -> waiting_queue);
     return 0;
 }
@@ -45,48 +56,153 @@ void mutex_destroy(mutex_t *mp)
     mp -> status = MUTEX_UNAVAILABLE;
 }
 
+/** @brief Make a thread the holder of a mutex
+ *
+ *  @param mp the mutex, locked
+ *  @param tcb the new holder, NULL while booting
+ *  @return void
+ */
+static void set_owner(mutex_t *mp, TCB *tcb)
+{
+    mp -> owner = tcb;
+    mp -> tid = (tcb == NULL) ? -1 : tcb -> tid;
+    if (tcb != NULL)
+        list_insert_last(&tcb -> held_mutexes, &mp -> held_node);
+}
+
+/** @brief Compute the priority a thread should run at
+ *
+ *  That is its own priority, or the highest priority of the threads
+ *  waiting for a mutex it holds.
+ *
+ *  @param tcb the thread
+ *  @return the priority
+ */
+int mutex_inherited_priority(TCB *tcb)
+{
+    int priority = tcb -> base_priority;
+    node *m, *w;
+    for (m = list_begin(&tcb -> held_mutexes); m != NULL; m = m -> next)
+    {
+        mutex_t *mp = list_entry(m, mutex_t, held_node);
+        for (w = list_begin(&mp -> waiting_queue); w != NULL; w = w -> next)
+        {
+            TCB *waiter = list_entry(w, TCB, mutex_waiting_queue_node);
+            if (waiter -> priority < priority)
+                priority = waiter -> priority;
+        }
+    }
+    return priority;
+}
+
+/** @brief Take a thread that is being killed out of the waiting queue
+ *         of the mutex it waits for
+ *
+ *  The holders along the chain may run at a priority the thread lent
+ *  them, they get it back.
+ *
+ *  @param tcb the thread, nothing happens if it does not wait
+ *  @return void
+ */
+void mutex_cancel_wait(TCB *tcb)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    mutex_t *mp = tcb -> blocked_on;
+    if (mp != NULL)
+    {
+        list_delete(&mp -> waiting_queue, &tcb -> mutex_waiting_queue_node);
+        tcb -> blocked_on = NULL;
+        TCB *holder = mp -> owner;
+        while (holder != NULL)
+        {
+            runq_set_priority(holder, mutex_inherited_priority(holder));
+            holder = (holder -> blocked_on == NULL) ?
+                     NULL : holder -> blocked_on -> owner;
+        }
+    }
+    set_eflags(eflags);
+}
+
 /** @brief The function to lock a mutex
  *
- *  @param a pointer to the list to be initialized
+ *  @param mp A pointer to the mutex
  *  @return nothing
  */
 void mutex_lock(mutex_t *mp)
 {
-    int is_locked = 0;
-    while ((is_locked = atomic_xchange(&(mp->status))))  {
-        lprintf("The current thread that holds the lock is %d", mp -> tid);
-        list_insert_last(&mp -> waiting_queue, &current_thread -> mutex_waiting_queue_node);
-        schedule(mp -> tid);     // yield to the thread who holds the lock
-        list_delete(&mp -> waiting_queue, &current_thread -> mutex_waiting_queue_node);
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+
+    // Nobody can hold it while booting, there is a single flow of control
+    if (mp -> status != MUTEX_LOCKED || current_thread == NULL)
+    {
+        mp -> status = MUTEX_LOCKED;
+        set_owner(mp, current_thread);
+        set_eflags(eflags);
+        return;
+    }
+
+    list_insert_last(&mp -> waiting_queue,
+                     &current_thread -> mutex_waiting_queue_node);
+    current_thread -> blocked_on = mp;
+
+    // Lend our priority along the chain of holders
+    TCB *holder = mp -> owner;
+    while (holder != NULL && current_thread -> priority < holder -> priority)
+    {
+        runq_set_priority(holder, current_thread -> priority);
+        holder = (holder -> blocked_on == NULL) ?
+                 NULL : holder -> blocked_on -> owner;
     }
-    mp -> tid = current_thread -> tid;
-    // lprintf("Lock the mutex %p",mp);
 
+    // mutex_unlock dequeues us and makes us the holder before we run again
+    current_thread -> state = THREAD_MUTEX;
+    schedule(-1);
+    set_eflags(eflags);
 }
 
-/** @brief The function to initialize the doubly linked list
+/** @brief The function to unlock a mutex, handing it to the first waiter
  *
- *  @param a pointer to the list to be initialized
+ *  @param mp A pointer to the mutex
  *  @return nothing
  */
 void mutex_unlock(mutex_t *mp)
 {
-    // lprintf("unlock the mutex %p",mp);
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+
+    if (mp -> owner != NULL)
+        list_delete(&mp -> owner -> held_mutexes, &mp -> held_node);
+
+    TCB *next = NULL;
     if (mp -> waiting_queue.length != 0)
     {
-        TCB *target = NULL;
-
-        // Peek the first waiting thread and yield to it
-        node *n = list_begin(&mp -> waiting_queue);
-        n = n -> next;
-        target = list_entry(n, TCB, mutex_waiting_queue_node);
-        mp -> tid = -1;
-        mp -> status = MUTEX_UNLOCKED;
-        yield(target -> tid);
-    } else {
+        next = list_entry(list_begin(&mp -> waiting_queue), TCB,
+                          mutex_waiting_queue_node);
+        list_delete(&mp -> waiting_queue, &next -> mutex_waiting_queue_node);
+        next -> blocked_on = NULL;
+        set_owner(mp, next);
+        // It may hold mutexes others are waiting for, keep them boosted
+        next -> priority = mutex_inherited_priority(next);
+        next -> state = THREAD_RUNNABLE;
+        runq_insert_woken(next);
+    }
+    else
+    {
+        mp -> owner = NULL;
         mp -> tid = -1;
         mp -> status = MUTEX_UNLOCKED;
     }
 
-}
+    // Give back what the waiters of this mutex lent us
+    if (current_thread != NULL)
+        runq_set_priority(current_thread,
+                          mutex_inherited_priority(current_thread));
+    set_eflags(eflags);
 
+    // Not from inside the scheduler, which unlocks with interrupts off
+    if (next != NULL && current_thread != NULL && (eflags & EFL_IF) &&
+        next -> priority < current_thread -> priority)
+        schedule(-1);
+}
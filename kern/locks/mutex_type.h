@@ -14,15 +14,22 @@
 #define MUTEX_UNLOCKED 0
 #define MUTEX_UNAVAILABLE -1
 #include "datastructure/linked_list.h"
+
+struct TCB_t;
+
 typedef struct mutex {
     int status;			// The status for the mutex
     int tid;			// The thread who holds it
-    list waiting_queue; // The queue of threads that holds the lock
+    struct TCB_t *owner;	// The thread who holds it, NULL while booting
+    list waiting_queue; // The threads that wait for the lock, in FIFO order
+    node held_node;		// Belongs to the held_mutexes list of the owner
 } mutex_t;
 
 int mutex_init(mutex_t *mp);
 void mutex_lock(mutex_t *mp);
 void mutex_unlock(mutex_t *mp);
 void mutex_destroy(mutex_t *mp);
+int mutex_inherited_priority(struct TCB_t *tcb);
+void mutex_cancel_wait(struct TCB_t *tcb);
 
 #endif /* _MUTEX_TYPE_H */
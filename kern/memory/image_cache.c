@@ -0,0 +1,134 @@
+/** @file image_cache.c
+ *
+ *  @brief This file keeps the frames of read-only program pages so that
+ *         they are loaded once and shared by every process of a program
+ *
+ *  There is one cache per exec2obj entry, indexed by the position of the
+ *  executable in the table of contents. A cache covers the pages from
+ *  the start of text to the end of rodata and remembers, for each page,
+ *  the frame it was loaded into (0 if it was never loaded).
+ *
+ *  The cache holds its own reference on every frame it remembers, so
+ *  the code of a program stays loaded after its last process exits and
+ *  the next exec maps it without copying. Executables never change, so
+ *  a cached frame never goes stale.
+ *
+ *  Caches are allocated with interrupts enabled and only read or filled
+ *  with interrupts disabled, from the page fault handler.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#include "image_cache.h"
+#include "vm_routines.h"
+#include <exec2obj.h>
+#include <malloc.h>
+#include <string.h>
+#include <stddef.h>
+#include <page.h>
+#include <x86/asm.h>
+#include <eflags.h>
+
+typedef struct image_cache
+{
+    // first page covered by the cache
+    uint32_t base;
+    // number of pages covered
+    uint32_t npages;
+    // frame of each page, 0 if not loaded yet
+    uint32_t *frames;
+} IMAGE_CACHE;
+
+static IMAGE_CACHE image_cache[MAX_NUM_APP_ENTRIES];
+
+/** @brief Find the cache slot of a page, interrupts must be off
+ *
+ *  @param entry index of the executable in the exec2obj table
+ *  @param virtual_addr any address in the page
+ *  @return the slot, NULL if the page is not covered by a cache
+ **/
+static uint32_t *cache_slot(int entry, uint32_t virtual_addr)
+{
+    if (entry < 0 || entry >= MAX_NUM_APP_ENTRIES) return NULL;
+    IMAGE_CACHE *cache = &image_cache[entry];
+    if (cache -> frames == NULL || virtual_addr < cache -> base) return NULL;
+
+    uint32_t index = (virtual_addr - cache -> base) / PAGE_SIZE;
+    if (index >= cache -> npages) return NULL;
+    return &cache -> frames[index];
+}
+
+/** @brief Make sure the cache of an executable exists
+ *
+ *  The layout of an executable never changes, so the cache is only
+ *  created by the first exec of it.
+ *
+ *  @param entry index of the executable in the exec2obj table
+ *  @param base start of the read-only part of the program
+ *  @param len length of the read-only part of the program
+ *  @return 0 on success, -1 if out of memory, in which case the program
+ *          simply runs with private copies of its pages
+ **/
+int image_cache_init(int entry, uint32_t base, uint32_t len)
+{
+    if (entry < 0 || entry >= MAX_NUM_APP_ENTRIES || len == 0) return -1;
+    if (image_cache[entry].frames != NULL) return 0;
+
+    uint32_t first = DEFLAG_ADDR(base);
+    uint32_t npages = (base + len - first + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t *frames = (uint32_t *)malloc(npages * sizeof(uint32_t));
+    if (frames == NULL) return -1;
+    memset(frames, 0, npages * sizeof(uint32_t));
+
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    if (image_cache[entry].frames != NULL)
+    {
+        // someone else exec'd the same program meanwhile
+        set_eflags(eflags);
+        free(frames);
+        return 0;
+    }
+    image_cache[entry].base = first;
+    image_cache[entry].npages = npages;
+    image_cache[entry].frames = frames;
+    set_eflags(eflags);
+    return 0;
+}
+
+/** @brief Take a reference on the cached frame of a page
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param entry index of the executable in the exec2obj table
+ *  @param virtual_addr any address in the page
+ *  @return the frame, with its refcount raised for the caller, 0 if the
+ *          page is not cached
+ **/
+uint32_t image_cache_lookup(int entry, uint32_t virtual_addr)
+{
+    uint32_t *slot = cache_slot(entry, virtual_addr);
+    if (slot == NULL || *slot == 0) return 0;
+    share_frame(*slot);
+    return *slot;
+}
+
+/** @brief Remember the frame a page was just loaded into
+ *
+ *  The cache takes its own reference on the frame. Must be called with
+ *  interrupts disabled.
+ *
+ *  @param entry index of the executable in the exec2obj table
+ *  @param virtual_addr any address in the page
+ *  @param frame the frame holding the loaded page
+ *  @return void
+ **/
+void image_cache_insert(int entry, uint32_t virtual_addr, uint32_t frame)
+{
+    uint32_t *slot = cache_slot(entry, virtual_addr);
+    if (slot == NULL || *slot != 0) return;
+    share_frame(frame);
+    *slot = frame;
+}
@@ -0,0 +1,22 @@
+/**
+ * @file image_cache.h
+ *
+ * @brief Frames of read-only program pages shared by every process
+ *        running the same executable.
+ *
+ * @author Xianqi Zeng (xianqiz)
+ * @author Tianyuan Ding (tding)
+ *
+ */
+
+#ifndef _IMAGE_CACHE_H
+#define _IMAGE_CACHE_H
+#include <stdint.h>
+
+int image_cache_init(int entry, uint32_t base, uint32_t len);
+
+uint32_t image_cache_lookup(int entry, uint32_t virtual_addr);
+
+void image_cache_insert(int entry, uint32_t virtual_addr, uint32_t frame);
+
+#endif /*_IMAGE_CACHE_H*/
@@ -0,0 +1,195 @@
+/** @file region.c
+ *
+ *  @brief This file keeps track of the user memory regions of a process
+ *
+ *  Every region (the program image, the initial stack and each new_pages
+ *  allocation) is a VA_INFO stored in an AVL tree in the PCB, keyed by
+ *  its base address. Regions never overlap, so the region containing an
+ *  address is the one with the largest base not above it, and all of
+ *  insert, remove, lookup and overlap checks are O(log n).
+ *
+ *  Threads of a process share its tree, so it is only changed with
+ *  interrupts disabled. VA_INFOs are allocated and freed outside of
+ *  those sections.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#include "region.h"
+#include <malloc.h>
+#include <stddef.h>
+#include <x86/asm.h>
+#include <eflags.h>
+
+/** @brief Last byte of a region, computed this way since the stack
+ *         region ends at 4GB
+ */
+#define REGION_LAST(r)  ((r) -> virtual_addr + (r) -> len - 1)
+
+/** @brief Find the region containing an address, interrupts must be off
+ *
+ *  @param pcb the process
+ *  @param addr any user address
+ *  @return the region, NULL if the address is in none
+ **/
+static VA_INFO *find_locked(PCB *pcb, uint32_t addr)
+{
+    tree_node *n = tree_floor(&pcb -> va, addr);
+    if (n == NULL) return NULL;
+    VA_INFO *region = tree_entry(n, VA_INFO, va_node);
+    if (REGION_LAST(region) < addr) return NULL;
+    return region;
+}
+
+/** @brief Check if a range intersects any region, interrupts must be off
+ *
+ *  @param pcb the process
+ *  @param addr base of the range
+ *  @param len length of the range, not 0
+ *  @return 1 if it intersects a region, 0 otherwise
+ **/
+static int overlaps_locked(PCB *pcb, uint32_t addr, uint32_t len)
+{
+    // The last region starting inside or before the range is the only
+    // candidate, those after it start beyond the range
+    tree_node *n = tree_floor(&pcb -> va, addr + len - 1);
+    if (n == NULL) return 0;
+    VA_INFO *region = tree_entry(n, VA_INFO, va_node);
+    return REGION_LAST(region) >= addr;
+}
+
+/** @brief Record a new region for a process
+ *
+ *  @param pcb the process
+ *  @param addr page aligned base of the region
+ *  @param len page aligned length of the region
+ *  @param type one of the REGION_ kinds
+ *  @return 0 on success, -1 if out of memory, if the range wraps around
+ *          or if it overlaps an existing region
+ **/
+int region_add(PCB *pcb, uint32_t addr, uint32_t len, int type)
+{
+    if (len == 0 || addr + (len - 1) < addr) return -1;
+
+    VA_INFO *region = malloc(sizeof(VA_INFO));
+    if (region == NULL) return -1;
+    region -> virtual_addr = addr;
+    region -> len = len;
+    region -> type = type;
+    region -> va_node.key = addr;
+
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    if (overlaps_locked(pcb, addr, len))
+    {
+        set_eflags(eflags);
+        free(region);
+        return -1;
+    }
+    tree_insert(&pcb -> va, &region -> va_node);
+    set_eflags(eflags);
+    return 0;
+}
+
+/** @brief Forget the region based at an address
+ *
+ *  Checking and removing happen at once, so two threads removing the
+ *  same region cannot both succeed.
+ *
+ *  @param pcb the process
+ *  @param addr base of the region
+ *  @param type only remove a region of this kind, -1 for any kind
+ *  @param len if not NULL, set to the length of the removed region
+ *  @return 0 on success, -1 if no region of that kind is based there
+ **/
+int region_remove(PCB *pcb, uint32_t addr, int type, uint32_t *len)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    tree_node *n = tree_search(&pcb -> va, addr);
+    if (n == NULL ||
+        (type != -1 && tree_entry(n, VA_INFO, va_node) -> type != type))
+    {
+        set_eflags(eflags);
+        return -1;
+    }
+    tree_delete(&pcb -> va, addr);
+    set_eflags(eflags);
+
+    VA_INFO *region = tree_entry(n, VA_INFO, va_node);
+    if (len != NULL) *len = region -> len;
+    free(region);
+    return 0;
+}
+
+/** @brief Find the region containing an address
+ *
+ *  @param pcb the process
+ *  @param addr any user address
+ *  @return the region, NULL if the address is in none
+ **/
+VA_INFO *region_find(PCB *pcb, uint32_t addr)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    VA_INFO *region = find_locked(pcb, addr);
+    set_eflags(eflags);
+    return region;
+}
+
+/** @brief Check if a range intersects any region of a process
+ *
+ *  @param pcb the process
+ *  @param addr base of the range
+ *  @param len length of the range
+ *  @return 1 if it intersects a region, 0 otherwise
+ **/
+int region_overlaps(PCB *pcb, uint32_t addr, uint32_t len)
+{
+    if (len == 0) return 0;
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    int result = overlaps_locked(pcb, addr, len);
+    set_eflags(eflags);
+    return result;
+}
+
+/** @brief Give a forked child a copy of its parent's regions
+ *
+ *  The child is not running yet, so only the parent's tree needs
+ *  protection, and the parent is the one forking.
+ *
+ *  @param dest the child, its tree must be initialized
+ *  @param src the parent
+ *  @return 0 on success, -1 if out of memory
+ **/
+int region_copy(PCB *dest, PCB *src)
+{
+    tree_node *n;
+    for (n = tree_first(&src -> va); n != NULL;
+         n = tree_next(&src -> va, n -> key))
+    {
+        VA_INFO *region = tree_entry(n, VA_INFO, va_node);
+        if (region_add(dest, region -> virtual_addr, region -> len,
+                       region -> type) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/** @brief Forget every region of a process, used on exec and when the
+ *         process is reaped
+ *
+ *  @param pcb the process
+ *  @return void
+ **/
+void region_destroy(PCB *pcb)
+{
+    tree_node *n;
+    while ((n = tree_first(&pcb -> va)) != NULL)
+    {
+        region_remove(pcb, n -> key, -1, NULL);
+    }
+}
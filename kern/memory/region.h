@@ -0,0 +1,28 @@
+/**
+ * @file region.h
+ *
+ * @brief Per process index of user memory regions.
+ *
+ * @author Xianqi Zeng (xianqiz)
+ * @author Tianyuan Ding (tding)
+ *
+ */
+
+#ifndef _REGION_H
+#define _REGION_H
+#include <stdint.h>
+#include "control_block.h"
+
+int region_add(PCB *pcb, uint32_t addr, uint32_t len, int type);
+
+int region_remove(PCB *pcb, uint32_t addr, int type, uint32_t *len);
+
+VA_INFO *region_find(PCB *pcb, uint32_t addr);
+
+int region_overlaps(PCB *pcb, uint32_t addr, uint32_t len);
+
+int region_copy(PCB *dest, PCB *src);
+
+void region_destroy(PCB *pcb);
+
+#endif /*_REGION_H*/
@@ -0,0 +1,22 @@
+/**
+ * @file tlb.h
+ *
+ * @brief TLB maintenance routines.
+ *
+ * @author Xianqi Zeng (xianqiz)
+ * @author Tianyuan Ding (tding)
+ *
+ */
+
+#ifndef _TLB_H
+#define _TLB_H
+
+/** @brief Drop the TLB entry of a single page, global or not, without
+ *         flushing the rest of the TLB
+ *
+ *  @param va any virtual address inside the page
+ *  @return void
+ */
+void invlpg(void *va);
+
+#endif /* _TLB_H */
@@ -0,0 +1,156 @@
+/** @file usercopy.c
+ *
+ *  @brief This file includes routines that move data between the kernel
+ *         and user memory of the current process
+ *
+ *  Every range is handled one page at a time: the page table entry of
+ *  the page is checked once, then the whole part of the range that lies
+ *  in that page is copied. A page is accepted if it is a present user
+ *  page (writable or copy-on-write when we write to it) or if it is
+ *  still zero-fill-on-demand or not loaded from the executable yet (and
+ *  writable when we write to it), in which case touching it simply
+ *  faults it in.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#include "usercopy.h"
+#include "vm_routines.h"
+#include "control_block.h"
+#include <common_kern.h>
+#include <string.h>
+#include <page.h>
+
+#define LEN_MIN(x,y) ((x) < (y) ? (x) : (y))
+
+/** @brief Check if the kernel may access a user page of the current
+ *         process on its behalf
+ *
+ *  @param addr any address in the page
+ *  @param write 1 if the kernel is going to write to the page
+ *  @return 1 if the access is allowed, 0 otherwise
+ **/
+static int user_page_ok(uint32_t addr, int write)
+{
+    if (addr < USER_MEM_START) return 0;
+
+    uint32_t pde = current_thread -> pcb -> PD[VA_PD_IND(addr)];
+    if (!(pde & PTE_PRESENT)) return 0;
+    uint32_t pte = ((uint32_t *)DEFLAG_ADDR(pde))[VA_PT_IND(addr)];
+
+    if (IS_LAZY_PTE(pte)) return !write || (pte & PTE_RW);
+    if ((pte & (PTE_PRESENT | PTE_USER)) != (PTE_PRESENT | PTE_USER))
+        return 0;
+    if (write && !(pte & (PTE_RW | PTE_COW))) return 0;
+    return 1;
+}
+
+/** @brief Copy a range of user memory into the kernel
+ *
+ *  @param dst kernel destination
+ *  @param usrc user source
+ *  @param len number of bytes to copy
+ *  @return 0 on success, -1 if part of the range is not readable user
+ *          memory, in which case dst may be partially written
+ **/
+int copy_from_user(void *dst, const void *usrc, uint32_t len)
+{
+    uint32_t addr = (uint32_t)usrc;
+    char *out = (char *)dst;
+
+    // the range may end exactly at 4GB, but not wrap around
+    if (len > 0 && addr + (len - 1) < addr) return -1;
+    while (len > 0)
+    {
+        uint32_t chunk = LEN_MIN(len, PAGE_SIZE - (addr & (PAGE_SIZE - 1)));
+        if (!user_page_ok(addr, 0)) return -1;
+        memcpy(out, (void *)addr, chunk);
+        addr += chunk;
+        out += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+/** @brief Copy kernel data into a range of user memory
+ *
+ *  @param udst user destination
+ *  @param src kernel source
+ *  @param len number of bytes to copy
+ *  @return 0 on success, -1 if part of the range is not writable user
+ *          memory, in which case udst may be partially written
+ **/
+int copy_to_user(void *udst, const void *src, uint32_t len)
+{
+    uint32_t addr = (uint32_t)udst;
+    const char *in = (const char *)src;
+
+    // the range may end exactly at 4GB, but not wrap around
+    if (len > 0 && addr + (len - 1) < addr) return -1;
+    while (len > 0)
+    {
+        uint32_t chunk = LEN_MIN(len, PAGE_SIZE - (addr & (PAGE_SIZE - 1)));
+        if (!user_page_ok(addr, 1)) return -1;
+        memcpy((void *)addr, in, chunk);
+        addr += chunk;
+        in += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+/** @brief Check that a range of user memory could be written now,
+ *         without writing it
+ *
+ *  @param udst user range
+ *  @param len number of bytes in the range
+ *  @return 1 if copy_to_user to the range would succeed, 0 otherwise
+ **/
+int user_writable(void *udst, uint32_t len)
+{
+    uint32_t addr = (uint32_t)udst;
+
+    if (len > 0 && addr + (len - 1) < addr) return 0;
+    while (len > 0)
+    {
+        uint32_t chunk = LEN_MIN(len, PAGE_SIZE - (addr & (PAGE_SIZE - 1)));
+        if (!user_page_ok(addr, 1)) return 0;
+        addr += chunk;
+        len -= chunk;
+    }
+    return 1;
+}
+
+/** @brief Copy a NUL terminated user string into the kernel
+ *
+ *  The string is measured and copied in the same pass.
+ *
+ *  @param dst kernel destination, at least max bytes long
+ *  @param usrc user string
+ *  @param max size of dst, including the terminating NUL
+ *  @return the length of the string, -1 if it is not readable user
+ *          memory or does not fit in max bytes
+ **/
+int copy_string_from_user(char *dst, const char *usrc, int max)
+{
+    uint32_t addr = (uint32_t)usrc;
+    int copied = 0;
+
+    while (copied < max)
+    {
+        if (!user_page_ok(addr, 0)) return -1;
+        int chunk = LEN_MIN(max - copied,
+                            PAGE_SIZE - (addr & (PAGE_SIZE - 1)));
+        const char *in = (const char *)addr;
+        int i;
+        for (i = 0; i < chunk; ++i)
+        {
+            dst[copied++] = in[i];
+            if (in[i] == '\0') return copied - 1;
+        }
+        addr += chunk;
+    }
+    return -1;
+}
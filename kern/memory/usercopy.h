@@ -0,0 +1,23 @@
+/**
+ * @file usercopy.h
+ *
+ * @brief Checked copies between the kernel and user memory.
+ *
+ * @author Xianqi Zeng (xianqiz)
+ * @author Tianyuan Ding (tding)
+ *
+ */
+
+#ifndef _USERCOPY_H
+#define _USERCOPY_H
+#include <stdint.h>
+
+int copy_from_user(void *dst, const void *usrc, uint32_t len);
+
+int copy_to_user(void *udst, const void *src, uint32_t len);
+
+int user_writable(void *udst, uint32_t len);
+
+int copy_string_from_user(char *dst, const char *usrc, int max);
+
+#endif /*_USERCOPY_H*/
@@ -18,12 +18,40 @@
 #include <common_kern.h>
 #include "control_block.h"
 #include <page.h>
+#include <x86/asm.h>
+#include <eflags.h>
+#include <lmm/lmm.h>
+#include <malloc/malloc_internal.h>
+#include <assert.h>
+#include "tlb.h"
+#include "region.h"
+#include "image_cache.h"
 
 #define PAGE_LEN (PAGE_SIZE>>2)             //1024
-#define TOTAL_PHYS_FRAMES (PAGE_SIZE<<4)    //65536
 
-static KF *frame_base;      // always fixed
-static KF *free_frame;      // points to the first free frame where refcount = 0
+static KF *frame_base;      // always fixed, one KF per physical frame
+static KF *free_frame;      // top of the free stack, NULL if no free frame
+static int total_frames;    // number of physical frames in the machine
+static uint32_t *kern_pd;   // kernel mappings, copied into every pd
+
+// The kernel owns the first 16MB, i.e. the first 4 page directory entries
+#define KERNEL_PDES     (USER_MEM_START >> 22)
+
+// Frames that are free and already zeroed, refilled while idle. They
+// are counted in free_frame_num just like the frames on free_frame.
+static KF *zero_frame;
+static int zero_frame_count;
+
+// Keep at most this many zeroed frames, zero this many per idle tick
+#define ZERO_POOL_SIZE  256
+#define ZERO_POOL_BATCH 4
+
+// The last pages of the kernel direct map are taken out of the kernel
+// heap and used as slots to temporarily map arbitrary frames
+#define TEMP_MAP_SLOTS  8
+#define TEMP_MAP_BASE   (USER_MEM_START - TEMP_MAP_SLOTS * PAGE_SIZE)
+static uint32_t *temp_map_pte;              // pte of the first slot
+static int temp_map_used[TEMP_MAP_SLOTS];
 
 /** @brief Initialize the whole memory system, immediately
  *         called when the kernel enters to enable paging
@@ -35,43 +63,39 @@ static KF *free_frame;      // points to the first free frame where refcount = 0
  **/
 void mm_init()
 {
+    // Nobody may allocate the pages used as temporary mapping slots
+    lmm_remove_free(&malloc_lmm, (void *)TEMP_MAP_BASE,
+                    TEMP_MAP_SLOTS * PAGE_SIZE);
+
     init_free_frame();
 
     // allocate 4k memory for kernel page directory
-    uint32_t *kern_pd = (uint32_t *)memalign(PAGE_SIZE, 4 * 4);
+    kern_pd = (uint32_t *)memalign(PAGE_SIZE, PAGE_SIZE);
+    memset(kern_pd, 0, PAGE_SIZE);
     set_cr3((uint32_t)kern_pd);
-    ////lprintf("the pd uint32_t is %u", (unsigned int)kern_pd);
-    ////lprintf("the pd  is %p", kern_pd);
-    ////lprintf("cr3 is :%u", ((unsigned int)get_cr3()));
-
-
-    //initialize the first four entries of the kernel pd, note that
-    // the first 4 pts (kernel pts)
-    // are fixed at the beginning, it is then copied to the pts
-    //for the first running program.
-    // map first 4 entries in page directory, for kernel address space
 
+    // The kernel direct map is copied into every page directory. All but
+    // the last 4MB are mapped with global 4MB pages, the last one keeps a
+    // page table because the temporary mapping slots live in it
     int i, j;
-    for (i = 0; i < 4; ++i)
+    for (i = 0; i < KERNEL_PDES - 1; ++i)
     {
-        uint32_t current_pt = (uint32_t)memalign(PAGE_SIZE, PAGE_SIZE);
-        for (j = 0; j < PAGE_LEN; ++j)
-        {
-            uint32_t k = acquire_free_frame();
-
-            // //lprintf("the page address is %x", (unsigned int)k);
-
-            // should mark as global
-            *((uint32_t *)(current_pt) + j) =  k | 0x103;
-        }
-
-        kern_pd[i] = current_pt | 0x107;
-
-        //lprintf("the pt is %x", (unsigned int)current_pt);
+        kern_pd[i] = ADDFLAG((uint32_t)i << 22,
+                             PDE_PAGE_SIZE | PTE_GLOBAL | PTE_RW | PTE_PRESENT);
+    }
+    uint32_t *last_pt = (uint32_t *)memalign(PAGE_SIZE, PAGE_SIZE);
+    for (j = 0; j < PAGE_LEN; ++j)
+    {
+        last_pt[j] = ADDFLAG(((uint32_t)i << 22) | ((uint32_t)j << 12),
+                             PTE_GLOBAL | PTE_RW | PTE_PRESENT);
     }
+    kern_pd[i] = ADDFLAG((uint32_t)last_pt, PTE_RW | PTE_PRESENT);
+    temp_map_pte = last_pt + VA_PT_IND(TEMP_MAP_BASE);
 
+    set_cr4(get_cr4() | CR4_PSE);
     set_cr4(get_cr4() | CR4_PGE);
-    set_cr0(get_cr0() | CR0_PG);
+    // Write protect makes kernel writes to copy-on-write pages fault too
+    set_cr0(get_cr0() | CR0_PG | CR0_WP);
 
 }
 
@@ -99,11 +123,11 @@ int virtual_map_physical(uint32_t *PD, uint32_t pd_index, uint32_t pt_index)
         {
             //lprintf("acquiring...");
             //lprintf("Frame frame is %p", free_frame);
-            free_frame_addr = acquire_free_frame();
-            if (free_frame_addr == 0)
+            if (reserve_frames(1) < 0)
             {
                 return -1;
             }
+            free_frame_addr = acquire_reserved_zero_frame();
             //lprintf("2389457923875923845 frame is %p", free_frame);
 
             //lprintf("acquiring finished");
@@ -117,11 +141,11 @@ int virtual_map_physical(uint32_t *PD, uint32_t pd_index, uint32_t pt_index)
         //lprintf("Frame frame is %p", free_frame);
 
         //lprintf("acquiring...");
-        free_frame_addr = acquire_free_frame();
-        if (free_frame_addr == 0)
+        if (reserve_frames(1) < 0)
         {
             return -1;
         }
+        free_frame_addr = acquire_reserved_zero_frame();
         //lprintf("Frame frame haahahahais %p", free_frame);
 
         //lprintf("acquiring finished with freeframe %x", (unsigned int)free_frame_addr);
@@ -139,8 +163,7 @@ int virtual_map_physical(uint32_t *PD, uint32_t pd_index, uint32_t pt_index)
 
     //lprintf("The freed address is %x",
     // (unsigned int)(pd_index << 22 | pt_index << 12));
-    /* ZFOD the virtual address but not the physical address */
-    memset((void *)(pd_index << 22 | pt_index << 12), 0, PAGE_SIZE);
+    /* The frame comes zeroed, from the pool or the temporary mapping slots */
     //lprintf("Return virtual2physical");
     return 0;
 }
@@ -178,6 +201,11 @@ int virtual_unmap_physical(uint32_t *PD, uint32_t pd_index, uint32_t pt_index)
         {
             return -1;    // Ok, this virtual memory is already unmapped
         }
+        else if (IS_LAZY_PTE(pte))
+        {
+            unreserve_frames(1);    // never touched, give back reservation
+            PT[pt_index] = 0;
+        }
         else
         {
             uint32_t physical_addr = DEFLAG_ADDR(pte);
@@ -284,15 +312,94 @@ int free_pages(uint32_t *pd, uint32_t virtual_addr, size_t size)
     return 0;
 }
 
+/** @brief Map a range of user memory to be filled on demand
+ *
+ *  No frame is touched here: one frame per page that is not mapped yet
+ *  is reserved against free_frame_num, and the page table entry only
+ *  records how the page should be filled on first access. Pages in the
+ *  range that are already mapped are left alone.
+ *
+ *  @param pd the page directory to map into
+ *  @param virtual_addr start of the range
+ *  @param size length of the range in bytes
+ *  @param marker the entry to store, ZFOD_PTE or FILE_PTE
+ *  @return 0 on success, -1 if there are not enough free frames
+ **/
+static int allocate_lazy_pages(uint32_t *pd, uint32_t virtual_addr,
+                               size_t size, uint32_t marker)
+{
+    uint32_t first = virtual_addr / PAGE_SIZE;
+    uint32_t last = (virtual_addr + size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t page;
+    int needed = 0;
+
+    if (size == 0) return 0;
+
+    // First pass: count and reserve, so that we never map half a range
+    for (page = first; page < last; ++page)
+    {
+        uint32_t pde = pd[page / PAGE_LEN];
+        if (pde == 0 || ((uint32_t *)DEFLAG_ADDR(pde))[page % PAGE_LEN] == 0)
+            needed++;
+    }
+    if (reserve_frames(needed) < 0) return -1;
+
+    for (page = first; page < last; ++page)
+    {
+        uint32_t pd_index = page / PAGE_LEN;
+        if (pd[pd_index] == 0)
+        {
+            uint32_t *PT = (uint32_t *)memalign(PAGE_SIZE, PAGE_SIZE);
+            memset((void *)PT, 0, PAGE_SIZE);
+            pd[pd_index] = ((uint32_t)PT) | 0x7;
+        }
+        uint32_t *PT = (uint32_t *)DEFLAG_ADDR(pd[pd_index]);
+        if (PT[page % PAGE_LEN] == 0)
+            PT[page % PAGE_LEN] = marker;
+    }
+    return 0;
+}
+
+/** @brief Map a range of user memory zero-fill-on-demand
+ *
+ *  @param pd the page directory to map into
+ *  @param virtual_addr start of the range
+ *  @param size length of the range in bytes
+ *  @return 0 on success, -1 if there are not enough free frames
+ **/
+int allocate_zfod_pages(uint32_t *pd, uint32_t virtual_addr, size_t size)
+{
+    return allocate_lazy_pages(pd, virtual_addr, size, ZFOD_PTE);
+}
+
+/** @brief Map a range of the program image to be loaded from the
+ *         executable on first access
+ *
+ *  Read-only pages are loaded through the image cache, so they end up
+ *  sharing one frame with every other process of the same program.
+ *
+ *  @param pd the page directory to map into
+ *  @param virtual_addr start of the range
+ *  @param size length of the range in bytes
+ *  @param writable 0 to map the range read-only
+ *  @return 0 on success, -1 if there are not enough free frames
+ **/
+int allocate_file_pages(uint32_t *pd, uint32_t virtual_addr, size_t size,
+                        int writable)
+{
+    return allocate_lazy_pages(pd, virtual_addr, size,
+                               writable ? FILE_PTE : (FILE_PTE & ~PTE_RW));
+}
+
 uint32_t *init_pd()
 {
     // void *old_cr3 = (void *)get_cr3();
     uint32_t *pd = (uint32_t *)memalign(PAGE_SIZE, PAGE_SIZE); // Allocate pd for process
     memset(pd, 0, PAGE_SIZE);  // clean
     int i = 0;
-    for (i = 0; i < 4; ++i)
+    for (i = 0; i < KERNEL_PDES; ++i)
     {
-        pd[i] = DEFLAG_ADDR((((uint32_t *)get_cr3())[i])) | 0x107;
+        pd[i] = kern_pd[i];
 
         //lprintf("The directory is %x",(unsigned int)pd[i]);
     }
@@ -341,112 +448,470 @@ void destroy_page_table(uint32_t pt)
         {
             continue;
         }
-        uint32_t physical_addr = DEFLAG_ADDR(pte);
-        release_free_frame(physical_addr);
+        if (IS_LAZY_PTE(pte))
+        {
+            unreserve_frames(1);
+        }
+        else
+        {
+            release_free_frame(DEFLAG_ADDR(pte));
+        }
         ((uint32_t *)pt)[i] = 0;      // Unmap this page
     }
     sfree((uint32_t *)pt, PAGE_SIZE);
 }
 
 
-/** @brief Initialize the free list, which keeps track the current free frames.
+/** @brief Initialize the free stack, which keeps track the current free frames.
  *
- *  If top == bottom, we know there are nothing in the queue.
+ *  Free frames are chained through their KF next pointers, so both
+ *  acquire and release are a single push or pop. Frames of the kernel
+ *  direct map are never free, they are owned by the kernel from the
+ *  start.
  *
- *  @param q The pointer to the queue
- *  @return int 1 means not empty and 0 otherwise
+ *  @return void
  **/
 void init_free_frame()
 {
     int i ;
-    free_frame_num = machine_phys_frames();
-    //initizlie the free frame array
-    // bunch of pointers that points to pages
-    frame_base = (KF *)memalign(PAGE_SIZE, 8 * TOTAL_PHYS_FRAMES);
-    for (i = 0; i < TOTAL_PHYS_FRAMES; ++i)
+    int kernel_frames = USER_MEM_START / PAGE_SIZE;
+    total_frames = machine_phys_frames();
+    free_frame_num = total_frames - kernel_frames;
+    //initizlie the frame array, one entry for each physical frame
+    frame_base = (KF *)memalign(PAGE_SIZE, sizeof(KF) * total_frames);
+    free_frame = NULL;
+    for (i = total_frames - 1; i >= kernel_frames; --i)
     {
         frame_base[i].refcount = 0;
-        if (i != TOTAL_PHYS_FRAMES-1) frame_base[i].next = &(frame_base[i + 1]);
-        if ((void *)&frame_base[i] == (void *)0x1d9ff8)
-        {
-            //lprintf("The next for 0x1d9ff8 is %p %d", frame_base[i].next, i);
-        }
+        frame_base[i].next = free_frame;
+        free_frame = &frame_base[i];
+    }
+    for (i = 0; i < kernel_frames; ++i)
+    {
+        frame_base[i].refcount = 1;
+        frame_base[i].next = NULL;
     }
-    free_frame = frame_base;
     //lprintf("out there: free frame is %x", (unsigned int)free_frame);
 
 }
 
-/** @brief Returns a frame frame from the current free list and
-set the next free list
- *         to be the struct where refcount = 0;
- *
- *  If top == bottom, we know there are nothing in the queue.
+/** @brief Pops a frame from the free stack
  *
- *  @param q The pointer to the queue
- *  @return the physical free frame address, always 4KB aligned
+ *  @return the physical free frame address, always 4KB aligned, or 0
+ *          if there is no free frame
  **/
 uint32_t acquire_free_frame()
 {
-    if (free_frame == NULL)
+    // Frame 0 always belongs to the kernel, so 0 means no free frame
+    if (reserve_frames(1) < 0)
+    {
+        return 0;
+    }
+    return acquire_reserved_frame();
+}
+
+/** @brief Drop a reference to a frame, the frame is pushed back to the
+ *         free stack only when refcount reaches 0.
+ *
+ *  @param address physical, 4KB aligned address of the frame
+ *  @return void
+ **/
+void release_free_frame(uint32_t address)
+{
+    //lprintf("ok, you want to release %x, %x",(unsigned int)address, (unsigned int)frame_base);
+    KF *frame = &frame_base[address / PAGE_SIZE];
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+
+    frame -> refcount--;
+    // Only the last sharer gives the frame back
+    if (frame -> refcount == 0)
+    {
+        frame -> next = free_frame;
+        free_frame = frame;
+        free_frame_num++;
+    }
+
+    set_eflags(eflags);
+    return;
+}
+
+/** @brief Promise frames to a caller without handing them out yet
+ *
+ *  Reserved frames stay on the free stack but are no longer counted in
+ *  free_frame_num, so later acquire_free_frame calls cannot take them.
+ *
+ *  @param num number of frames to reserve
+ *  @return 0 on success, -1 if there are not enough free frames
+ **/
+int reserve_frames(int num)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    if (num > free_frame_num)
     {
+        set_eflags(eflags);
         return -1;
     }
-    uint32_t offset = (uint32_t)free_frame - (uint32_t)frame_base;
-    uint32_t index = offset / 8;
-    uint32_t physical_frame_addr = index * PAGE_SIZE;
-    frame_base[index].refcount++;
+    free_frame_num -= num;
+    set_eflags(eflags);
+    return 0;
+}
+
+/** @brief Give back frames reserved but never taken
+ *
+ *  @param num number of frames to unreserve
+ *  @return void
+ **/
+void unreserve_frames(int num)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    free_frame_num += num;
+    set_eflags(eflags);
+}
+
+/** @brief Pops a frame off a free stack and gives it its first reference
+ *
+ *  @param stack the free stack to pop from, must not be empty
+ *  @return the physical frame address, always 4KB aligned
+ **/
+static uint32_t pop_frame(KF **stack)
+{
+    KF *frame = *stack;
+    *stack = frame -> next;
+    frame -> next = NULL;
+    frame -> refcount = 1;
 
-    // Loop until free_frame points to a free physical page
-    // //lprintf("I gave you %x", (unsigned int)physical_frame_addr);
+    return (uint32_t)(frame - frame_base) * PAGE_SIZE;
+}
 
-    while (free_frame -> refcount != 0)
+/** @brief Map a physical frame into a free temporary mapping slot
+ *
+ *  The slots live in the kernel page tables, so they are visible from
+ *  every address space and only the slot itself has to be flushed.
+ *
+ *  @param address physical, 4KB aligned address of the frame
+ *  @return the kernel virtual address the frame is mapped at
+ **/
+void *temp_map(uint32_t address)
+{
+    int i;
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    for (i = 0; i < TEMP_MAP_SLOTS; ++i)
     {
-        free_frame = free_frame -> next;
+        if (!temp_map_used[i]) break;
     }
-    // if(physical_frame_addr>= 0x01000000)
-    // //lprintf("I gave you %x", (unsigned int)physical_frame_addr);
+    // Every user holds at most two slots with interrupts disabled
+    assert(i < TEMP_MAP_SLOTS);
+    temp_map_used[i] = 1;
+    set_eflags(eflags);
+
+    void *va = (void *)(TEMP_MAP_BASE + i * PAGE_SIZE);
+    temp_map_pte[i] = ADDFLAG(address, PTE_PRESENT | PTE_RW);
+    invlpg(va);
+    return va;
+}
 
-    free_frame_num --;
+/** @brief Release a slot taken by temp_map
+ *
+ *  @param va the address returned by temp_map
+ *  @return void
+ **/
+void temp_unmap(void *va)
+{
+    int i = ((uint32_t)va - TEMP_MAP_BASE) / PAGE_SIZE;
+    temp_map_pte[i] = 0;
+    invlpg(va);
+    temp_map_used[i] = 0;
+}
 
+/** @brief Clear a physical frame through a temporary mapping slot
+ *
+ *  @param address physical, 4KB aligned address of the frame
+ *  @return void
+ **/
+static void zero_physical_frame(uint32_t address)
+{
+    void *va = temp_map(address);
+    memset(va, 0, PAGE_SIZE);
+    temp_unmap(va);
+}
 
-    return physical_frame_addr;
-    // Note that it's possible that there is no free physical
-    // page, so in this case we
-    // need to handle this situation
+/** @brief Pops a frame that was reserved earlier with reserve_frames
+ *
+ *  Dirty frames are handed out first so that the zeroed ones are kept
+ *  for callers that need them.
+ *
+ *  @return the physical free frame address, always 4KB aligned
+ **/
+uint32_t acquire_reserved_frame()
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    uint32_t address;
+    if (free_frame != NULL)
+    {
+        address = pop_frame(&free_frame);
+    }
+    else
+    {
+        address = pop_frame(&zero_frame);
+        zero_frame_count--;
+    }
+    set_eflags(eflags);
+    return address;
 }
 
-/** @brief Release a frame frame and mark it as freed only when refcount = 0.
- *         If so, let free_frame point to it.
+/** @brief Pops a zeroed frame that was reserved earlier with
+ *         reserve_frames
  *
- *  If top == bottom, we know there are nothing in the queue.
+ *  Takes a frame from the pre-zeroed pool if there is one, otherwise
+ *  a dirty frame is zeroed right away.
  *
- *  @param address address must be both physical
-  address and 4KB aligned (really ?)
+ *  @return the physical free frame address, always 4KB aligned
  **/
-void release_free_frame(uint32_t address)
+uint32_t acquire_reserved_zero_frame()
 {
-    //lprintf("ok, you want to release %x, %x",(unsigned int)address, (unsigned int)frame_base);
-    uint32_t index = address / PAGE_SIZE;
-    //lprintf("indexxxx %d", (int)index);
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    uint32_t address;
+    if (zero_frame != NULL)
+    {
+        address = pop_frame(&zero_frame);
+        zero_frame_count--;
+        zero_pool_hits++;
+    }
+    else
+    {
+        address = pop_frame(&free_frame);
+        zero_physical_frame(address);
+        zero_pool_misses++;
+    }
+    set_eflags(eflags);
+    return address;
+}
 
-    frame_base[index].refcount--;
-    // MAGIC_BREAK;
-    // If there is no reference count, let free_frame point to it
-    if (frame_base[index].refcount == 0)
+/** @brief Zero a few free frames and move them to the pre-zeroed pool
+ *
+ *  Called by the idle thread, so the work is done when nobody else
+ *  wants the CPU.
+ *
+ *  @return the number of frames zeroed, 0 once the pool is full
+ **/
+int refill_zero_pool()
+{
+    int i;
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    for (i = 0; i < ZERO_POOL_BATCH && zero_frame_count < ZERO_POOL_SIZE
+                && free_frame != NULL; ++i)
     {
-        //lprintf("free base index is %x", (unsigned int) &frame_base[index] );
+        KF *frame = free_frame;
+        free_frame = frame -> next;
+        zero_physical_frame((uint32_t)(frame - frame_base) * PAGE_SIZE);
+        frame -> next = zero_frame;
+        zero_frame = frame;
+        zero_frame_count++;
+    }
+    set_eflags(eflags);
+    return i;
+}
+
+/** @brief Add one more reference to an allocated frame, used when a
+ *         frame is shared copy-on-write between address spaces
+ *
+ *  @param address physical, 4KB aligned address of the frame
+ *  @return void
+ **/
+void share_frame(uint32_t address)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    frame_base[address / PAGE_SIZE].refcount++;
+    set_eflags(eflags);
+}
 
+/** @brief Give the faulting process a private, writable copy of a
+ *         copy-on-write page
+ *
+ *  If we are the only one left referencing the frame, we simply take
+ *  it back as writable. Otherwise a fresh frame is mapped into a
+ *  temporary slot, the page is copied into it and the faulting address
+ *  is remapped to the new frame. Only the faulting page is flushed from
+ *  the TLB. Must be called with interrupts disabled.
+ *
+ *  @param pd the page directory of the faulting process
+ *  @param virtual_addr the faulting virtual address
+ *  @return 0 on success, -1 if the page is not copy-on-write or there
+ *          is no free frame left
+ **/
+int handle_cow_fault(uint32_t *pd, uint32_t virtual_addr)
+{
+    uint32_t pde = pd[VA_PD_IND(virtual_addr)];
+    if (pde == 0) return -1;
 
-        free_frame = &frame_base[index];
+    uint32_t *PT = (uint32_t *)DEFLAG_ADDR(pde);
+    uint32_t pte = PT[VA_PT_IND(virtual_addr)];
+    if (!(pte & PTE_PRESENT) || !(pte & PTE_COW)) return -1;
 
-        //lprintf("out there: free frame is %x", (unsigned int) free_frame );
+    uint32_t old_frame = DEFLAG_ADDR(pte);
+    uint32_t flags = (GET_FLAG(pte) & ~PTE_COW) | PTE_RW;
+    void *page = (void *)DEFLAG_ADDR(virtual_addr);
 
+    // Last sharer, no need to copy
+    if (frame_base[old_frame / PAGE_SIZE].refcount == 1)
+    {
+        PT[VA_PT_IND(virtual_addr)] = ADDFLAG(old_frame, flags);
+        invlpg(page);
+        return 0;
     }
 
-    free_frame_num++;
+    uint32_t new_frame = acquire_free_frame();
+    if (new_frame == 0) return -1;
+    void *copy = temp_map(new_frame);
+    memcpy(copy, page, PAGE_SIZE);
+    temp_unmap(copy);
 
-    return;
+    PT[VA_PT_IND(virtual_addr)] = ADDFLAG(new_frame, flags);
+    invlpg(page);
+
+    release_free_frame(old_frame);
+    return 0;
+}
+
+/** @brief Back a zero-fill-on-demand page with its reserved frame
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @param pd the page directory of the faulting process
+ *  @param virtual_addr the faulting virtual address
+ *  @return 0 on success, -1 if the page is not zero-fill-on-demand
+ **/
+int handle_zfod_fault(uint32_t *pd, uint32_t virtual_addr)
+{
+    uint32_t pde = pd[VA_PD_IND(virtual_addr)];
+    if (pde == 0) return -1;
+
+    uint32_t *PT = (uint32_t *)DEFLAG_ADDR(pde);
+    uint32_t pte = PT[VA_PT_IND(virtual_addr)];
+    if (!IS_ZFOD_PTE(pte)) return -1;
+
+    // Non-present entries are never cached, no need to flush the TLB
+    uint32_t frame = acquire_reserved_zero_frame();
+    PT[VA_PT_IND(virtual_addr)] = ADDFLAG(frame,
+                                   (GET_FLAG(pte) & ~PTE_ZFOD) | PTE_PRESENT);
+    return 0;
+}
+
+/** @brief Load a page of the program image from the executable into
+ *         its reserved frame
+ *
+ *  The page is zeroed, then the part of each file backed section that
+ *  lies in it is copied from the exec2obj image, so a page that text
+ *  or data shares with bss comes out right too. A read-only page is
+ *  taken from the image cache when it is there, and put into it after
+ *  loading otherwise. Must be called with interrupts disabled.
+ *
+ *  @param pd the page directory of the faulting process
+ *  @param image the program image layout of the faulting process
+ *  @param virtual_addr the faulting virtual address
+ *  @return 0 on success, -1 if the page is not file backed
+ **/
+int handle_file_fault(uint32_t *pd, const IMAGE_INFO *image,
+                      uint32_t virtual_addr)
+{
+    uint32_t pde = pd[VA_PD_IND(virtual_addr)];
+    if (pde == 0) return -1;
+
+    uint32_t *PT = (uint32_t *)DEFLAG_ADDR(pde);
+    uint32_t pte = PT[VA_PT_IND(virtual_addr)];
+    if (!IS_FILE_PTE(pte) || image -> bytes == NULL) return -1;
+
+    uint32_t page = DEFLAG_ADDR(virtual_addr);
+    uint32_t frame;
+    uint32_t flags = (GET_FLAG(pte) & ~PTE_FILE) | PTE_PRESENT;
+
+    // Another process of the program may have loaded it already, then
+    // the frame reserved for this page is not needed
+    if (!(pte & PTE_RW))
+    {
+        frame = image_cache_lookup(image -> entry, page);
+        if (frame != 0)
+        {
+            unreserve_frames(1);
+            PT[VA_PT_IND(virtual_addr)] = ADDFLAG(frame, flags);
+            return 0;
+        }
+    }
+
+    frame = acquire_reserved_frame();
+    char *fill = (char *)temp_map(frame);
+    memset(fill, 0, PAGE_SIZE);
+
+    int i;
+    for (i = 0; i < IMAGE_SECTIONS; ++i)
+    {
+        uint32_t start = image -> start[i];
+        uint32_t end = start + image -> len[i];
+        if (image -> len[i] == 0 || end <= page || start >= page + PAGE_SIZE)
+            continue;
+        uint32_t from = start > page ? start : page;
+        uint32_t to = end < page + PAGE_SIZE ? end : page + PAGE_SIZE;
+        memcpy(fill + (from - page),
+               image -> bytes + image -> offset[i] + (from - start),
+               to - from);
+    }
+    temp_unmap(fill);
+
+    if (!(pte & PTE_RW))
+        image_cache_insert(image -> entry, page, frame);
+
+    // Non-present entries are never cached, no need to flush the TLB
+    PT[VA_PT_IND(virtual_addr)] = ADDFLAG(frame, flags);
+    return 0;
+}
+
+/** @brief Try to resolve a page fault in the current address space
+ *
+ *  Touching a zero-fill-on-demand page or a page of the program image
+ *  that is not loaded yet, and writing to a copy-on-write page can be
+ *  resolved, every other fault is left to the swexn handler (or kills
+ *  the thread).
+ *
+ *  @param virtual_addr the faulting address, read from cr2
+ *  @param error_code the error code pushed by the processor
+ *  @return 0 if the fault is resolved and the instruction can be
+ *          restarted, -1 otherwise
+ **/
+int resolve_page_fault(uint32_t virtual_addr, uint32_t error_code)
+{
+    if (virtual_addr < USER_MEM_START || current_thread == NULL)
+        return -1;
+
+    uint32_t *pd = current_thread -> pcb -> PD;
+    int result = -1;
+
+    // Nothing to do outside of the process's regions
+    if (region_find(current_thread -> pcb, virtual_addr) == NULL)
+        return -1;
+
+    // The kernel may fault on user memory with interrupts disabled
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    if (!(error_code & PF_ERR_PRESENT))
+    {
+        result = handle_zfod_fault(pd, virtual_addr);
+        if (result < 0)
+            result = handle_file_fault(pd, &current_thread -> pcb -> image,
+                                       virtual_addr);
+    }
+    else if (error_code & PF_ERR_WRITE)
+        result = handle_cow_fault(pd, virtual_addr);
+    set_eflags(eflags);
+
+    return result;
 }
 
 
@@ -515,7 +980,8 @@ int addr_has_mapping(void *addr) {
     /*No mapped page table*/
     if (PT == NULL) return 0;
     
-    uint32_t pt_entry = DEFLAG_ADDR(PT[pt_index]);
+    // Zero-fill-on-demand entries count as mapped
+    uint32_t pt_entry = PT[pt_index];
     /*No mapped page table entry*/
     if (pt_entry == 0) return 0;
     /*passed all tests*/
@@ -12,6 +12,7 @@
 #define _VM_ROUTINES_H
 #include <stdint.h>
 #include <types.h>
+#include "mem_internals.h"
  
 void mm_init();
 
@@ -23,6 +24,11 @@ int allocate_pages(uint32_t *pd, uint32_t virtual_addr, size_t size);
 
 int free_pages(uint32_t *pd, uint32_t virtual_addr, size_t size);
 
+int allocate_zfod_pages(uint32_t *pd, uint32_t virtual_addr, size_t size);
+
+int allocate_file_pages(uint32_t *pd, uint32_t virtual_addr, size_t size,
+                        int writable);
+
 uint32_t *init_pd();
 
 void copy_page_directory(uint32_t *pd);
@@ -43,6 +49,31 @@ uint32_t acquire_free_frame();
 
 void release_free_frame(uint32_t address);
 
+int reserve_frames(int num);
+
+void unreserve_frames(int num);
+
+uint32_t acquire_reserved_frame();
+
+uint32_t acquire_reserved_zero_frame();
+
+int refill_zero_pool();
+
+void *temp_map(uint32_t address);
+
+void temp_unmap(void *va);
+
+void share_frame(uint32_t address);
+
+int handle_cow_fault(uint32_t *pd, uint32_t virtual_addr);
+
+int handle_zfod_fault(uint32_t *pd, uint32_t virtual_addr);
+
+int handle_file_fault(uint32_t *pd, const IMAGE_INFO *image,
+                      uint32_t virtual_addr);
+
+int resolve_page_fault(uint32_t virtual_addr, uint32_t error_code);
+
 int is_user_addr(void *addr);
 
 int addr_has_mapping(void *addr);
@@ -55,4 +86,31 @@ int addr_has_mapping(void *addr);
 #define VA_PD_IND(x)			 (x >> 22)
 #define VA_PT_IND(x)			 ((x & 0x3ff000) >> 12)
 
+/* Page table entry flags */
+#define PTE_PRESENT              0x1
+#define PTE_RW                   0x2
+#define PTE_USER                 0x4
+/* Page directory entry maps a 4MB page instead of a page table */
+#define PDE_PAGE_SIZE            0x80
+#define PTE_GLOBAL               0x100
+/* Available-to-software bit: writable page shared read-only after fork */
+#define PTE_COW                  0x200
+/* Available-to-software bit: non-present page that is zero filled on
+ * first touch, a frame is already reserved for it */
+#define PTE_ZFOD                 0x400
+#define ZFOD_PTE                 (PTE_ZFOD | PTE_USER | PTE_RW)
+#define IS_ZFOD_PTE(pte)         (((pte) & (PTE_ZFOD | PTE_PRESENT)) == PTE_ZFOD)
+/* Available-to-software bit: non-present page of the program image that
+ * is filled from the executable on first touch, a frame is already
+ * reserved for it */
+#define PTE_FILE                 0x800
+#define FILE_PTE                 (PTE_FILE | PTE_USER | PTE_RW)
+#define IS_FILE_PTE(pte)         (((pte) & (PTE_FILE | PTE_PRESENT)) == PTE_FILE)
+/* Either kind of non-present page that holds a frame reservation */
+#define IS_LAZY_PTE(pte)         (IS_ZFOD_PTE(pte) || IS_FILE_PTE(pte))
+
+/* Page fault error code bits */
+#define PF_ERR_PRESENT           0x1
+#define PF_ERR_WRITE             0x2
+
 #endif /*_VM_ROUTINES_H*/
\ No newline at end of file
@@ -0,0 +1,22 @@
+/**
+ * @file bitmap.h
+ *
+ * @brief Bit scanning routines.
+ *
+ * @author Xianqi Zeng (xianqiz)
+ * @author Tianyuan Ding (tding)
+ *
+ */
+
+#ifndef _BITMAP_H
+#define _BITMAP_H
+#include <stdint.h>
+
+/** @brief Find the lowest set bit of a word with a single bsf
+ *
+ *  @param word the word to scan
+ *  @return the index of the lowest set bit, -1 if the word is 0
+ */
+int find_first_set(uint32_t word);
+
+#endif /* _BITMAP_H */
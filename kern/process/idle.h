@@ -0,0 +1,21 @@
+/**
+ * @file idle.h
+ *
+ * @brief Halt routine of the idle thread.
+ *
+ * @author Xianqi Zeng (xianqiz)
+ * @author Tianyuan Ding (tding)
+ *
+ */
+
+#ifndef _IDLE_H
+#define _IDLE_H
+
+/** @brief Enable interrupts and halt until the next one, must be called
+ *         with interrupts disabled
+ *
+ *  @return void, after the interrupt has been handled
+ */
+void idle_halt();
+
+#endif /* _IDLE_H */
@@ -16,12 +16,19 @@
 #include "common_kern.h"
 #include "string.h"
 #include "eflags.h"
+#include <x86/asm.h>
 #include "locks/mutex_type.h"
 #include "enter_user_mode.h"
 #include "thread/thread_basic.h"
 #include "memory/vm_routines.h"
+#include "memory/region.h"
+#include "memory/image_cache.h"
 #include "process.h"
+#include "scheduler.h"
 #include "assert.h"
+#include <page.h>
+#include <loader.h>
+#include <exec2obj.h>
 
 /** @brief Release a frame frame and mark it as freed only when refcount = 0.
  *         If so, let free_frame point to it.
@@ -37,9 +44,51 @@ void process_init()
     list_init(&process_queue);
     mutex_init(&process_queue_lock);
     mutex_init(&print_lock);
+    hash_init(&pid_table);
     next_pid = 1;
 }
 
+/** @brief Make a process findable by its pid
+ *
+ *  @param process the process, its pid must be set
+ *  @return void
+ **/
+void process_register(PCB *process)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    process -> pid_node.key = process -> pid;
+    hash_insert(&pid_table, &process -> pid_node);
+    set_eflags(eflags);
+}
+
+/** @brief Forget the pid of a process whose last thread vanished
+ *
+ *  @param process the process, nothing happens if it is not registered
+ *  @return void
+ **/
+void process_unregister(PCB *process)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    hash_delete(&pid_table, &process -> pid_node);
+    set_eflags(eflags);
+}
+
+/** @brief Find a live process by its pid
+ *
+ *  @param pid the pid
+ *  @return the process, NULL if no live process has that pid
+ **/
+PCB *process_lookup(int pid)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    hash_node *n = hash_find(&pid_table, pid);
+    set_eflags(eflags);
+    return (n == NULL) ? NULL : hash_entry(n, PCB, pid_node);
+}
+
 
 /** @brief Release a frame frame and mark it as freed only when refcount = 0.
  *         If so, let free_frame point to it.
@@ -55,6 +104,7 @@ int process_create(const char *filename, int run)
     lprintf("%s", filename);
     // Allocate new pcb struct
     PCB *process = (PCB *)malloc(sizeof(PCB));
+    tree_init(&process -> va);
 
     //create a clean page directory
     process -> PD = init_pd();
@@ -83,11 +133,23 @@ int process_create(const char *filename, int run)
 
     list_init(&process -> threads);
     list_init(&process -> children);
+    wq_init(&process -> exit_waiters);
 
     list_insert_last(&process_queue, &process -> all_processes_node);
+    process_register(process);
 
     // Load the program, copy the content to the memory and get the eip
     unsigned int eip = program_loader(se_hdr, process);
+    if (eip == 0)
+    {
+        list_delete(&process_queue, &process -> all_processes_node);
+        process_unregister(process);
+        destroy_page_directory(process -> PD);
+        sfree(process -> PD, PAGE_SIZE);
+        region_destroy(process);
+        free(process);
+        return -1;
+    }
 
         // lprintf("shabi2");
         // MAGIC_BREAK;
@@ -133,13 +195,141 @@ int process_create(const char *filename, int run)
     return 0;
 }
 
-/** @brief Release a frame frame and mark it as freed only when refcount = 0.
- *         If so, let free_frame point to it.
+/** @brief Create the idle thread, which runs in the kernel only
  *
- *  If top == bottom, we know there are nothing in the queue.
+ *  It gets a process of its own with nothing but the kernel mapped, and
+ *  sits on the lowest run queue level, below every user priority. It
+ *  must be the first thread created so that it owns IDLE_TID.
  *
- *  @param address address must be both physical
- address and 4KB aligned (really ?)
+ *  @return void
+ **/
+void idle_create()
+{
+    PCB *process = (PCB *)malloc(sizeof(PCB));
+    tree_init(&process -> va);
+    process -> PD = init_pd();
+    process -> image.bytes = NULL;
+    process -> state = PROCESS_IDLE;
+    process -> pid = next_pid;
+    next_pid++;
+    process -> return_state = 0;
+    process -> children_count = 0;
+    process -> parent = NULL;
+    list_init(&process -> threads);
+    list_init(&process -> children);
+    wq_init(&process -> exit_waiters);
+    list_insert_last(&process_queue, &process -> all_processes_node);
+    process_register(process);
+
+    // Not queued by thr_create, it has to get its priority first
+    TCB *thread = thr_create(0, 1);
+    assert(thread -> tid == IDLE_TID);
+    list_insert_last(&process -> threads, &thread -> peer_threads_node);
+    thread -> pcb = process;
+    thread -> priority = thread -> base_priority = IDLE_PRIORITY;
+    thread -> state = THREAD_INIT;
+    runq_insert(thread);
+}
+
+/** @brief Find the bytes spanned by the program's sections
+ *
+ *  @param se_hdr the elf header of the program
+ *  @param low where the lowest address of any section is stored
+ *  @param high where the end of the highest section is stored
+ *  @return 0 on success, -1 if every section is empty
+ **/
+static int image_bounds(simple_elf_t se_hdr, uint32_t *low, uint32_t *high)
+{
+    unsigned long starts[4] = {se_hdr.e_txtstart, se_hdr.e_rodatstart,
+                               se_hdr.e_datstart, se_hdr.e_bssstart};
+    unsigned long lens[4] = {se_hdr.e_txtlen, se_hdr.e_rodatlen,
+                             se_hdr.e_datlen, se_hdr.e_bsslen};
+    int i;
+    *low = 0xffffffff;
+    *high = 0;
+    for (i = 0; i < 4; ++i)
+    {
+        if (lens[i] == 0) continue;
+        if (starts[i] < *low) *low = starts[i];
+        if (starts[i] + lens[i] > *high) *high = starts[i] + lens[i];
+    }
+    return (*high == 0) ? -1 : 0;
+}
+
+/** @brief Record the pages spanned by the program's sections as one
+ *         region
+ *
+ *  @param se_hdr the elf header of the program
+ *  @param process the process the program is loaded into
+ *  @return 0 on success, -1 on failure
+ **/
+static int add_image_region(simple_elf_t se_hdr, PCB *process)
+{
+    uint32_t low, high;
+    if (image_bounds(se_hdr, &low, &high) < 0) return -1;
+    low = DEFLAG_ADDR(low);
+    high = DEFLAG_ADDR((high + PAGE_SIZE - 1));
+    return region_add(process, low, high - low, REGION_ELF);
+}
+
+/** @brief Check if a page holds any byte of a section
+ *
+ *  @param page page aligned address
+ *  @param start start of the section
+ *  @param len length of the section
+ *  @return 1 if they intersect, 0 otherwise
+ **/
+static int page_intersects(uint32_t page, uint32_t start, uint32_t len)
+{
+    return len > 0 && start < page + PAGE_SIZE && start + len > page;
+}
+
+/** @brief Mark the pages of the program image to be filled on demand
+ *
+ *  A page that only holds text and rodata is mapped read-only, it is
+ *  loaded once and shared by every process of the program. A page that
+ *  also holds data or bss is loaded into a private writable frame, and
+ *  a page that only holds bss is zero-fill-on-demand.
+ *
+ *  @param se_hdr the elf header of the program
+ *  @param process the process the program is loaded into
+ *  @return 0 on success, -1 if there are not enough free frames
+ **/
+static int map_image_pages(simple_elf_t se_hdr, PCB *process)
+{
+    IMAGE_INFO *image = &process -> image;
+    uint32_t low, high;
+    if (image_bounds(se_hdr, &low, &high) < 0) return 0;
+
+    uint32_t page;
+    for (page = DEFLAG_ADDR(low); page < high; page += PAGE_SIZE)
+    {
+        int code = page_intersects(page, image -> start[IMAGE_TEXT],
+                                   image -> len[IMAGE_TEXT]) ||
+                   page_intersects(page, image -> start[IMAGE_RODATA],
+                                   image -> len[IMAGE_RODATA]);
+        int data = page_intersects(page, image -> start[IMAGE_DATA],
+                                   image -> len[IMAGE_DATA]);
+        int bss = page_intersects(page, se_hdr.e_bssstart, se_hdr.e_bsslen);
+        int result = 0;
+
+        if (code && !data && !bss)
+            result = allocate_file_pages(process -> PD, page, PAGE_SIZE, 0);
+        else if (code || data)
+            result = allocate_file_pages(process -> PD, page, PAGE_SIZE, 1);
+        else if (bss)
+            result = allocate_zfod_pages(process -> PD, page, PAGE_SIZE);
+        if (result < 0) return -1;
+    }
+    return 0;
+}
+
+/** @brief Load a program into the address space of a process
+ *
+ *  @param se_hdr the elf header of the program
+ *  @param process the process the program is loaded into
+ *  @return the entry point of the program, 0 if there is not enough
+ *          memory, the address space is then only partly set up
  **/
 unsigned int program_loader(simple_elf_t se_hdr, PCB *process) {
 
@@ -167,43 +357,51 @@ unsigned int program_loader(simple_elf_t se_hdr, PCB *process) {
     // lprintf("e_bsslen: %lu", se_hdr.e_bsslen);
 
 
-    /* Allocate memory for every area */
-    allocate_pages(process -> PD,
-                   (uint32_t)se_hdr.e_txtstart, se_hdr.e_txtlen);
-    allocate_pages(process -> PD,
-                   (uint32_t)se_hdr.e_rodatstart, se_hdr.e_rodatlen);
-    allocate_pages(process -> PD,
-                   (uint32_t)se_hdr.e_bssstart, se_hdr.e_bsslen);
-    allocate_pages(process -> PD,
-                   (uint32_t)se_hdr.e_datstart, se_hdr.e_datlen);
-    // MAGIC_BREAK;
-
-    allocate_pages(process -> PD,
-                   (uint32_t)0xffffe000, 8192); // possibly bugs here
+    /* Record the program image and the stack as regions */
+    if (add_image_region(se_hdr, process) < 0 ||
+        region_add(process, USER_STACK_BASE, USER_STACK_SIZE,
+                   REGION_STACK) < 0)
+        return 0;
 
-    lprintf("allocate_pages done!");
-    // *(int *)0xffffffff=3;
+    /* Only record where the sections are, their pages are loaded from
+     * the executable when they are first touched */
+    IMAGE_INFO *image = &process -> image;
+    image -> entry = find_exec_entry(se_hdr.e_fname);
+    assert(image -> entry >= 0);
+    image -> bytes = exec2obj_userapp_TOC[image -> entry].execbytes;
+    image -> start[IMAGE_TEXT] = se_hdr.e_txtstart;
+    image -> offset[IMAGE_TEXT] = se_hdr.e_txtoff;
+    image -> len[IMAGE_TEXT] = se_hdr.e_txtlen;
+    image -> start[IMAGE_RODATA] = se_hdr.e_rodatstart;
+    image -> offset[IMAGE_RODATA] = se_hdr.e_rodatoff;
+    image -> len[IMAGE_RODATA] = se_hdr.e_rodatlen;
+    image -> start[IMAGE_DATA] = se_hdr.e_datstart;
+    image -> offset[IMAGE_DATA] = se_hdr.e_datoff;
+    image -> len[IMAGE_DATA] = se_hdr.e_datlen;
+
+    // Read-only pages are shared through the cache of this executable
+    uint32_t code_start = se_hdr.e_txtstart;
+    uint32_t code_end = se_hdr.e_txtstart + se_hdr.e_txtlen;
+    uint32_t rodata_end = se_hdr.e_rodatstart + se_hdr.e_rodatlen;
+    if (se_hdr.e_txtlen == 0)
+    {
+        code_start = se_hdr.e_rodatstart;
+        code_end = rodata_end;
+    }
+    else if (se_hdr.e_rodatlen > 0)
+    {
+        if (se_hdr.e_rodatstart < code_start) code_start = se_hdr.e_rodatstart;
+        if (rodata_end > code_end) code_end = rodata_end;
+    }
+    image_cache_init(image -> entry, code_start, code_end - code_start);
 
-    int result = 0;
-    // MAGIC_BREAK;
-    // /* copy data from data field */
-    result += getbytes(se_hdr.e_fname, se_hdr.e_datoff, se_hdr.e_datlen,
-             (char *)se_hdr.e_datstart);
-    // MAGIC_BREAK;
-    result += getbytes(se_hdr.e_fname, se_hdr.e_txtoff, se_hdr.e_txtlen,
-             (char *)se_hdr.e_txtstart);
-    result += getbytes(se_hdr.e_fname, se_hdr.e_rodatoff, se_hdr.e_rodatlen,
-             (char *)se_hdr.e_rodatstart);
-    assert(result > 0);
-    memset((char *)se_hdr.e_bssstart, 0,  se_hdr.e_bsslen);
-
-    // map_readonly(process -> PD,
-    //                (uint32_t)se_hdr.e_txtstart, se_hdr.e_txtlen);
-    // map_readonly(process -> PD,
-    //                (uint32_t)se_hdr.e_rodatstart, se_hdr.e_rodatlen);
-    // map_readonly(process -> PD,
-    //                (uint32_t)se_hdr.e_bssstart, se_hdr.e_bsslen);
+    if (map_image_pages(se_hdr, process) < 0)
+        return 0;
 
+    // exec writes the arguments to the stack right away
+    if (allocate_pages(process -> PD,
+                       USER_STACK_BASE, USER_STACK_SIZE) < 0)
+        return 0;
 
     return se_hdr.e_entry;
 }
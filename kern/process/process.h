@@ -13,6 +13,14 @@
 #define _PROCESS_H
 #include <elf/elf_410.h>
 #include "control_block.h"
+
+/* The initial user stack, the top two pages of the address space */
+#define USER_STACK_BASE 0xffffe000
+#define USER_STACK_SIZE 8192
+
+// init is the first process after idle
+#define INIT_PID 2
+
 void process_init();
 
 
@@ -21,4 +29,12 @@ unsigned int program_loader(simple_elf_t se_hdr, PCB *process);
 
 int process_create(const char *filename, int run);
 
+void idle_create();
+
+void process_register(PCB *process);
+
+void process_unregister(PCB *process);
+
+PCB *process_lookup(int pid);
+
 #endif /* _PROCESS_H */
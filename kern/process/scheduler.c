@@ -22,18 +22,248 @@
 #include "enter_user_mode.h"
 #include "hardware/timer.h"
 #include "scheduler.h"
+#include "memory/vm_routines.h"
+#include "bitmap.h"
+#include "idle.h"
+#include "thread/thread_basic.h"
+#include "hardware/fpu.h"
 
-// We invoke context switch every 20 ticks
-#define SCHEDULE_INTERVAL 30
+// Set by tick when a waking sleeper takes the CPU from a thread that did
+// not ask to give it up, read and cleared by the next schedule
+static int preempting = 0;
 
+/** @brief Check if a thread in this state goes back to a run queue when
+ *         it is switched out
+ *
+ *  @param state the state of the thread
+ *  @return 1 if it stays runnable, 0 if it blocks or exits
+ **/
+static int still_runnable(int state)
+{
+    return state == THREAD_RUNNING || state == THREAD_RUNNABLE ||
+           state == THREAD_INIT;
+}
+
+/** @brief Empty all run queues and the sleep queue
+ *
+ *  @return void
+ **/
+void runq_init()
+{
+    int i;
+    for (i = 0; i < NUM_PRIORITIES; ++i)
+    {
+        list_init(&run_queues[i]);
+    }
+    runq_bitmap = 0;
+    runq_length = 0;
+    heap_init(&sleep_queue);
+}
+
+/** @brief Queue a runnable thread at the tail of its priority level
+ *
+ *  @param tcb the thread, must not be queued already
+ *  @return void
+ **/
+void runq_insert(TCB *tcb)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    int level = tcb -> priority;
+    list_insert_last(&run_queues[level], &tcb -> thread_list_node);
+    tcb -> runq_level = level;
+    runq_bitmap |= (1 << level);
+    runq_length++;
+    set_eflags(eflags);
+}
+
+/** @brief Queue a thread that was woken up at the head of its priority
+ *         level
+ *
+ *  A thread that blocked keeps the rest of its time slice, so it gets
+ *  to use it right away, but cannot run longer than that before going
+ *  to the tail like everyone else.
+ *
+ *  @param tcb the thread, must not be queued already
+ *  @return void
+ **/
+void runq_insert_woken(TCB *tcb)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    int level = tcb -> priority;
+    list_insert_first(&run_queues[level], &tcb -> thread_list_node);
+    tcb -> runq_level = level;
+    runq_bitmap |= (1 << level);
+    runq_length++;
+    set_eflags(eflags);
+}
+
+/** @brief Take a thread out of the run queues
+ *
+ *  @param tcb the thread, nothing happens if it is not queued
+ *  @return void
+ **/
+void runq_delete(TCB *tcb)
+{
+    if (tcb == NULL) return;
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    int level = tcb -> runq_level;
+    if (level >= 0)
+    {
+        list_delete(&run_queues[level], &tcb -> thread_list_node);
+        if (run_queues[level].length == 0)
+            runq_bitmap &= ~(1 << level);
+        tcb -> runq_level = -1;
+        runq_length--;
+    }
+    set_eflags(eflags);
+}
+
+/** @brief Dequeue the first thread of the highest non-empty level
+ *
+ *  Must be called with interrupts disabled.
+ *
+ *  @return the thread, NULL if no thread is runnable
+ **/
+TCB *runq_pick()
+{
+    int level = find_first_set(runq_bitmap);
+    if (level < 0) return NULL;
+    TCB *tcb = list_entry(list_begin(&run_queues[level]), TCB,
+                          thread_list_node);
+    runq_delete(tcb);
+    return tcb;
+}
+
+/** @brief Move a thread to another priority, keeping its place in the
+ *         run queues consistent
+ *
+ *  @param tcb the thread
+ *  @param priority the new priority
+ *  @return void
+ **/
+void runq_set_priority(TCB *tcb, int priority)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    if (tcb -> runq_level >= 0)
+    {
+        runq_delete(tcb);
+        tcb -> priority = priority;
+        runq_insert(tcb);
+    }
+    else
+    {
+        tcb -> priority = priority;
+    }
+    set_eflags(eflags);
+}
+
+/** @brief Make every sleeper whose wake up tick has come runnable
+ *
+ *  Only the sleepers that are due are touched. Must be called with
+ *  interrupts disabled.
+ *
+ *  @param now the current tick
+ *  @return 1 if a sleeper woke up that should preempt the current
+ *          thread, 0 otherwise
+ **/
+static int wake_sleepers(unsigned int now)
+{
+    int preempt = 0;
+    heap_node *n;
+    while ((n = heap_min(&sleep_queue)) != NULL && n -> key <= now)
+    {
+        heap_delete_min(&sleep_queue);
+        TCB *tcb = heap_entry(n, TCB, sleep_node);
+        tcb -> state = THREAD_RUNNABLE;
+        runq_insert_woken(tcb);
+        if (current_thread != NULL &&
+            tcb -> priority < current_thread -> priority)
+            preempt = 1;
+    }
+    return preempt;
+}
+
+/** @brief Report how long the CPU has been idle
+ *
+ *  @return the number of ticks spent in the idle thread since boot
+ **/
+unsigned int sys_get_idle_ticks()
+{
+    return idle_ticks;
+}
+
+/** @brief Take a sleeping thread out of the sleep queue, used when it is
+ *         killed before waking up
+ *
+ *  @param tcb the thread, nothing happens if it is not sleeping
+ *  @return void
+ **/
+void sleep_cancel(TCB *tcb)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    if (tcb -> state == THREAD_SLEEPING && tcb != current_thread)
+        heap_delete(&sleep_queue, &tcb -> sleep_node);
+    set_eflags(eflags);
+}
+
+/** @brief Pick how many ticks the timer may skip while idle
+ *
+ *  Nothing can become runnable before the next sleeper is due, except
+ *  from another interrupt, which wakes the idle thread up anyway.
+ *
+ *  @param now the current tick
+ *  @return the number of ticks until the next wake up
+ **/
+static unsigned int idle_interval(unsigned int now)
+{
+    heap_node *n = heap_min(&sleep_queue);
+    if (n == NULL) return TIMER_MAX_TICKS;
+    return n -> key > now ? n -> key - now : 1;
+}
+
+/** @brief The timer callback, charges the running thread for the ticks
+ *         it used and switches threads when its time slice is used up
+ *
+ *  @param numTicks the number of ticks since boot
+ *  @return void
+ **/
 void tick(unsigned int numTicks)
 {
+    static unsigned int last_tick = 0;
+    int idle = (current_thread != NULL && current_thread -> tid == IDLE_TID);
+    unsigned int elapsed = numTicks - last_tick;
+
+    if (idle) idle_ticks += elapsed;
+    last_tick = numTicks;
+    if (current_thread == NULL) return;     // still booting
 
-    if (numTicks % SCHEDULE_INTERVAL == 0)
+    if (!idle) current_thread -> slice_left -= (int)elapsed;
+
+    // A sleeper that should run before us does not wait for the next
+    // scheduling interval
+    if (wake_sleepers(numTicks))
     {
-        lprintf("5 seconds, let's context switch\n");
+        timer_set_interval(1);
+        preempting = 1;
+        schedule(-1);
+        return;
+    }
+
+    // Only sleep deadlines are pending, stop ticking until the next one
+    timer_set_interval(idle && runq_length == 0 ?
+                       idle_interval(numTicks) : 1);
+
+    // The slice is used up, go behind the other threads of our priority
+    // with a fresh one
+    if (!idle && current_thread -> slice_left <= 0)
+    {
+        current_thread -> slice_left = TIME_SLICE;
         schedule(-1);     // schedule
-        lprintf("\nNow we are running in a different thread");
     }
 
 }
@@ -49,23 +279,8 @@ void schedule(int tid)
 {
     // MAGIC_BREAK;
     disable_interrupts();
-    // Before actual context switching, we make sleeping thread to be
-    // runnable if it's the time to wake up
-    node *n;
-    for (n = list_begin(&blocked_queue); n != NULL; n = n -> next)
-    {
-        TCB *tcb = list_entry(n, TCB, thread_list_node);
-        if (tcb -> state == THREAD_SLEEPING)
-        {
-            // lprintf("find a sleeping thread");
-            if (tcb -> start_ticks + tcb -> duration < sys_get_ticks())
-            {
-                tcb -> state = THREAD_RUNNABLE;
-                list_delete(&blocked_queue, &tcb->thread_list_node);
-                list_insert_last(&runnable_queue, &tcb->thread_list_node);
-            }
-        }
-    }
+    int preempted = preempting;
+    preempting = 0;
 
     // Unless the current thread is non-schedulable, and there is no
     // runnable thread, calling schedule must
@@ -73,7 +288,7 @@ void schedule(int tid)
     // as possible
 
     lprintf("return or not, well, I am thread: %d and state %d", current_thread->tid, current_thread -> state);
-    lprintf("The length of runnable quueee is %d", runnable_queue.length);
+    lprintf("The length of runnable quueee is %d", runq_length);
     TCB *target = NULL;
 
     // for (n = list_begin(&runnable_queue); n != NULL; n = n -> next)
@@ -84,24 +299,39 @@ void schedule(int tid)
 
     // TODO, schedule halt for spinning
 
-    if (current_thread -> tid == 1 && runnable_queue.length == 0)
+    if (current_thread -> tid == IDLE_TID && runq_length == 0)
     {
         lprintf("reach here");
         // MAGIC_BREAK;
         return;
     }
 
+    // A thread that can keep running is only preempted by a thread of
+    // the same or a higher priority. The idle thread always gives way,
+    // whatever its priority field says, or a runnable thread at a level
+    // below it would never run.
+    if (tid == -1 && still_runnable(current_thread -> state) &&
+        current_thread -> tid != IDLE_TID &&
+        find_first_set(runq_bitmap) > current_thread -> priority)
+    {
+        enable_interrupts();
+        return;
+    }
+
     TCB *next_thread = NULL;
     if (tid == -1)
     {
-        // pop a thread from the runnable_queue
-        node *n  = list_delete_first(&runnable_queue);
-        next_thread = list_entry(n, TCB, thread_list_node);
+        // pop the first thread of the highest priority
+        next_thread = runq_pick();
     }
     else      // Search for a specific thread
     {
-        next_thread = list_search_tid(&runnable_queue, tid);
-        list_delete(&runnable_queue, &next_thread->thread_list_node);
+        next_thread = thr_lookup(tid);
+        // not runnable (e.g. a blocked lock holder), run anyone else
+        if (next_thread == NULL || next_thread -> runq_level < 0)
+            next_thread = runq_pick();
+        else
+            runq_delete(next_thread);
     }
     if (next_thread == NULL)
     {
@@ -116,14 +346,20 @@ void schedule(int tid)
         break;      // we don't put the current thread back to queue
 
     case THREAD_BLOCKED:
-        list_insert_last(&blocked_queue, &current_thread->thread_list_node);
+        // already in descheduled_threads, make_runnable may find it now
         mutex_unlock(&deschedule_lock);
         break;
+    case THREAD_SLEEPING:
+        heap_insert(&sleep_queue, &current_thread -> sleep_node);
+        break;
+    case THREAD_MUTEX:
+        break;      // already in the waiting queue of the mutex
+
     case THREAD_WAITING:
     case THREAD_READLINE:
-    case THREAD_SLEEPING:
+    case THREAD_FUTEX:
         lprintf("gotcha!");
-        list_insert_last(&blocked_queue, &current_thread->thread_list_node);
+        // already in the wait queue, put there by wq_wait
         // for (n = list_begin(&blocked_queue); n != NULL; n = n -> next)
         // {
         //     target = list_entry(n, TCB, thread_list_node);
@@ -137,7 +373,12 @@ void schedule(int tid)
         break;
 
     default:
-        list_insert_last(&runnable_queue, &current_thread->thread_list_node);
+        // A preempted thread did not use up its slice, it goes first
+        // again once the higher priority thread is done
+        if (preempted)
+            runq_insert_woken(current_thread);
+        else
+            runq_insert(current_thread);
         // for (n = list_begin(&blocked_queue); n != NULL; n = n -> next)
         // {
         //     target = list_entry(n, TCB, thread_list_node);
@@ -181,12 +422,19 @@ TCB *context_switch(TCB *current, TCB *next)
 {
     lprintf("Switch from current: %d, to next: %d\n", current->tid, next->tid);
 
-    // MAGIC_BREAK;
-    set_cr3((uint32_t)next -> pcb -> PD);
-    // MAGIC_BREAK;
-
+    // Threads of one process share the page directory, keep the TLB
+    if (current -> pcb != next -> pcb)
+    {
+        set_cr3((uint32_t)next -> pcb -> PD);
+        switches_cross_space++;
+    }
+    else
+    {
+        switches_same_space++;
+    }
 
     set_esp0((uint32_t)(next -> stack_base + next -> stack_size));
+    fpu_switch(next);
     do_switch(current, next, next -> state);
     // TCB *temp = next;
     // next = current;
@@ -209,6 +457,13 @@ void prepare_init_thread(TCB *next)
 {
     lprintf("%p", next);
     lprintf("105, run this thread");
+    if (next -> tid == IDLE_TID)
+    {
+        // The idle thread never leaves the kernel
+        next -> state = THREAD_RUNNING;
+        current_thread = next;
+        idle_loop();
+    }
     // set_cr3((uint32_t)next -> pcb -> PD);
     // set_esp0((uint32_t)(next -> stack_base + next -> stack_size));
     next -> state = THREAD_RUNNING;
@@ -229,21 +484,32 @@ void prepare_init_thread(TCB *next)
                     next -> registers.ss);
 }
 
-/** @brief The generic function to search for a specific tid in a list
+/** @brief The body of the idle thread
  *
- *  @param l the pointer to the node with that specific tid
- *  @return the node that matches the tid
- */
-TCB *list_search_tid(list *l, int tid)
+ *  It fills the zeroed frame pool while there is nothing else to do,
+ *  then halts until the next interrupt. Checking the run queues and
+ *  halting happen with interrupts disabled up to the hlt itself, so a
+ *  wake up cannot slip in between.
+ *
+ *  @return does not return
+ **/
+void idle_loop()
 {
-    if (l == NULL) return NULL;
-    node *temp = l -> head;
-    while (temp)
+    while (1)
     {
-        TCB *thread = list_entry(temp, TCB, thread_list_node);
-        if (thread -> tid == tid)
-            return thread;
-        temp = temp -> next;
+        disable_interrupts();
+        if (runq_length > 0)
+        {
+            schedule(-1);
+            continue;
+        }
+        enable_interrupts();
+
+        if (refill_zero_pool() > 0) continue;
+
+        disable_interrupts();
+        if (runq_length == 0)
+            idle_halt();
+        enable_interrupts();
     }
-    return NULL;
-}
\ No newline at end of file
+}
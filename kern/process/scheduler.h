@@ -13,12 +13,35 @@
 #define _SCHEDULER_H
 
  
+// The idle process is the first one created, so it owns the first tid
+#define IDLE_TID 1
+
+// Ticks a thread may run before threads of the same priority get a turn,
+// fixed at compile time, there is no system call to change it
+#define TIME_SLICE 5
+
 void schedule(int tid);
 
+void runq_init();
+
+void runq_insert(TCB *tcb);
+
+void runq_insert_woken(TCB *tcb);
+
+void runq_delete(TCB *tcb);
+
+TCB *runq_pick();
+
+void runq_set_priority(TCB *tcb, int priority);
+
+void sleep_cancel(TCB *tcb);
+
+void idle_loop();
+
+unsigned int sys_get_idle_ticks();
+
 TCB *context_switch(TCB *current, TCB *next);
 
 void prepare_init_thread(TCB *next);
 
-TCB *list_search_tid(list *l, int tid);
-
 #endif /* _SCHEDULER_H */
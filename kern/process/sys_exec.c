@@ -13,7 +13,14 @@
 #include "enter_user_mode.h"
 #include "process.h"
 #include "memory/vm_routines.h"
+#include "memory/region.h"
+#include "memory/usercopy.h"
+#include <exec2obj.h>
 #include "thread/thread_basic.h"
+#include "hardware/fpu.h"
+
+extern void sys_vanish(void);
+extern void sys_set_status(int status);
 
 #define ARGC_LIMIT 100
 #define ARGV_LIMIT 50
@@ -31,13 +38,12 @@
  **/
 int sys_exec(char *execname, char *argvec[])
 {
-    if (!is_user_addr(execname) || !addr_has_mapping(execname)) return -1;
-    if (!is_user_addr(argvec) || !addr_has_mapping(argvec)) return -1;
-    char *name = (char *)malloc(strlen(execname) + 1);
-    strncpy(name, execname,strlen(execname)+1);
-    // name = "swexn_uninstall_test";
+    // Bring the name and the arguments into the kernel before the old
+    // address space goes away, each string is walked only once
+    char name[MAX_EXECNAME_LEN];
+    if (copy_string_from_user(name, execname, MAX_EXECNAME_LEN) < 0)
+        return -1;
     lprintf("The execname is %s", name);
-    lprintf("char %s, argvec: %p", execname, argvec);
     simple_elf_t se_hdr;
     int result = elf_load_helper(&se_hdr, name);
     lprintf("after elf loader");
@@ -49,40 +55,31 @@ int sys_exec(char *execname, char *argvec[])
     }
 
     lprintf("in exec, program found, start to load");
-    // Count the number of arguments
+    // Copy the arguments to a kernel buffer, the kernel stack is too
+    // small to hold them
+    char *string = (char *)malloc(ARGC_LIMIT * (ARGV_LIMIT + 1));
+    if (string == NULL) return -1;
+    char *kernel_dest = string;
+    char *argv[ARGC_LIMIT + 1];
     int argc = 0;
-    while (argvec[argc] != 0)
+    while (1)
     {
-        argc++;
-        if (strlen(argvec[argc]) > ARGV_LIMIT)
+        char *arg;
+        if (copy_from_user(&arg, &argvec[argc], sizeof(char *)) < 0)
         {
+            free(string);
             return -1;
         }
-    }
-    if (argc > ARGC_LIMIT)
-    {
-        return -1;
-    }
-
-    // Count the length of total number of char to be copied
-    int total_len = 0;
-    int i = 0;
-    for (i = 0; i < argc; ++i)
-    {
-        total_len += (strlen(argvec[i]) + 1);
-    }
-
-    // Copy the content to the kernel stack
-    char string[total_len+1];
-    char *kernel_dest = (char *)string;
-    char *argv[argc + 1];
-
-    int k = 0;
-    for (k = 0; k < argc; k++)
-    {
-        argv[k] = kernel_dest;
-        strcpy(kernel_dest, argvec[k]);
-        kernel_dest += (strlen(argvec[k]) + 1);
+        if (arg == NULL) break;
+        int len;
+        if (argc == ARGC_LIMIT ||
+            (len = copy_string_from_user(kernel_dest, arg, ARGV_LIMIT + 1)) < 0)
+        {
+            free(string);
+            return -1;
+        }
+        argv[argc++] = kernel_dest;
+        kernel_dest += len + 1;
     }
     argv[argc] = NULL;
 
@@ -99,15 +96,31 @@ int sys_exec(char *execname, char *argvec[])
     PCB *process = current_thread -> pcb;
     
     // Unmap current page directory and free all its address space
+    uint32_t *old_pd = process -> PD;
     process -> PD = init_pd();
+    // Drop our references to the old frames, so that a parent sharing
+    // them copy-on-write gets them back writable without copying
+    destroy_page_directory(old_pd);
+    sfree(old_pd, 4096);
+    region_destroy(process);
+    // The new program starts with a clean FPU
+    fpu_release(current_thread);
 
     current_thread -> registers.eip = program_loader(se_hdr, process);
+    if (current_thread -> registers.eip == 0)
+    {
+        // The old program is gone, there is nothing left to return to
+        free(string);
+        sys_set_status(-2);
+        sys_vanish();
+    }
     // set up kernel stack pointer possibly bugs here
     set_esp0((uint32_t)(current_thread -> stack_base + current_thread -> stack_size));
 
     // Copy the content to the new user stack
     char *dest = (char *)0xffffffff;
     char *vector[argc + 1];
+    int k;
 
     for (k = 0; k < argc; k++)
     {
@@ -117,8 +130,10 @@ int sys_exec(char *execname, char *argvec[])
     }
     vector[argc] = NULL;
 
-    dest -= sizeof(int) * 5;
-    memcpy(dest, vector, sizeof(int) * 5);
+    free(string);
+
+    dest -= sizeof(char *) * (argc + 1);
+    memcpy(dest, vector, sizeof(char *) * (argc + 1));
     *((unsigned int *)(current_thread -> registers.esp)) = 0xffffc000;
     current_thread -> registers.esp -= 4;
 
@@ -1,6 +1,8 @@
 /** @file sys_fork.c
  *
- *  @brief This file includes the implementation fork using ZFOD.
+ *  @brief This file includes the implementation of fork. The child
+ *         shares every user frame with the parent copy-on-write; the
+ *         actual copy is done by the page fault handler on first write.
  *
  *  @author Xianqi Zeng (xianqiz)
  *  @author Tianyuan Ding (tding)
@@ -19,45 +21,59 @@
 #include "eflags.h"
 #include "locks/mutex_type.h"
 #include "memory/vm_routines.h"
+#include "memory/region.h"
 #include "mem_internals.h"
+#include "scheduler.h"
+#include "process.h"
+#include "thread/thread_basic.h"
+#include "hardware/fpu.h"
 
-typedef struct entry_info
-{
-    int pd_index;
-    int pt_index;
-    uint32_t free_virtual_addr;
-} entry_struct;
-
-static entry_struct entry;
-
-/** @brief Determine if the given queue is empty
+/** @brief Count the pages of an address space that are still
+ *         zero-fill-on-demand or not loaded from the executable
  *
- *  If top == bottom, we know there are nothing in the queue.
- *
- *  @param q The pointer to the queue
- *  @return int 1 means not empty and 0 otherwise
+ *  @param pd the page directory to inspect
+ *  @return the number of untouched pages that hold a reservation
  **/
-int find_free_entry(uint32_t *parent_directory)
+static int count_lazy_pages(uint32_t *pd)
 {
-    int i, j;
+    int i, j, count = 0;
     for (i = 4; i < PD_SIZE; ++i)
     {
-        uint32_t current_pde = DEFLAG_ADDR(parent_directory[i]);
-        if (current_pde == 0) continue;
+        uint32_t *pt = (uint32_t *)DEFLAG_ADDR(pd[i]);
+        if (pt == NULL) continue;
         for (j = 0; j < PT_SIZE; ++j)
         {
-            uint32_t current = DEFLAG_ADDR(((uint32_t *)current_pde)[j]);
-            if (current == 0)
-            {
-                entry.pd_index = i;
-                entry.pt_index = j;
-                entry.free_virtual_addr = (i << 22) | (j << 12);
-                return 1;
-                return 1;
-            }
+            if (IS_LAZY_PTE(pt[j])) count++;
         }
     }
-    return 0;
+    return count;
+}
+
+/** @brief Give back everything a fork took before it ran out of memory
+ *
+ *  The child is not visible to anyone yet, so it can be torn down
+ *  without locks. Its page tables hold one reservation per lazy page
+ *  they already copied, destroying them gives those back.
+ *
+ *  @param child_pcb the half built child process
+ *  @param child_tcb the half built child thread
+ *  @param reserved frames reserved but not yet copied into a page table
+ *  @return void
+ **/
+static void fork_undo(PCB *child_pcb, TCB *child_tcb, int reserved)
+{
+    if (child_pcb -> PD != NULL)
+    {
+        destroy_page_directory(child_pcb -> PD);
+        sfree(child_pcb -> PD, PD_SIZE * 4);
+    }
+    region_destroy(child_pcb);
+    fpu_release(child_tcb);
+    if (child_tcb -> stack_base != NULL)
+        free(child_tcb -> stack_base);
+    unreserve_frames(reserved);
+    free(child_tcb);
+    free(child_pcb);
 }
 
 /** @brief Determine if the given queue is empty
@@ -106,18 +122,24 @@ int sys_fork(void)
     TCB *child_tcb = (TCB *)malloc(sizeof(TCB));
     if (child_tcb == NULL)
     {
+        free(child_pcb);
         return -1;
     }
     PCB *parent_pcb = current_thread -> pcb;
     TCB *parent_tcb = current_thread;
     uint32_t *parent_directory = parent_pcb -> PD;
-    //Find a temprorary entry in parent pd for temporary mapping
-    //with the new physical frame
-    if (!find_free_entry(parent_directory))
+    // The child needs its own reservation for every page that is still
+    // zero-fill-on-demand or unloaded, take them all now so that fork
+    // fails cleanly
+    int reserved = count_lazy_pages(parent_directory);
+    if (reserve_frames(reserved) < 0)
     {
-        //didn't successfully find a free entry in current pcb;
+        free(child_tcb);
+        free(child_pcb);
         return -1;
     }
+    child_pcb -> PD = NULL;
+    tree_init(&child_pcb -> va);
 
     /* Step 3: set up the thread control block */
     mutex_init(&child_tcb -> tcb_mutex);
@@ -126,10 +148,19 @@ int sys_fork(void)
     child_tcb -> tid = next_tid;
     next_tid++;
     child_tcb -> state = THREAD_INIT;
+    child_tcb -> priority = child_tcb -> base_priority =
+        parent_tcb -> base_priority;
+    child_tcb -> runq_level = -1;
+    child_tcb -> slice_left = TIME_SLICE;
+    list_init(&child_tcb -> held_mutexes);
+    child_tcb -> blocked_on = NULL;
+    child_tcb -> waiting_in = NULL;
+    fpu_fork(parent_tcb, child_tcb);
     child_tcb -> stack_size = parent_tcb -> stack_size;
     child_tcb -> stack_base = memalign(4, child_tcb -> stack_size);
     if (child_tcb -> stack_base == NULL)
     {
+        fork_undo(child_pcb, child_tcb, reserved);
         return -1;
     }
     child_tcb -> esp = (uint32_t)child_tcb -> stack_base +
@@ -139,24 +170,32 @@ int sys_fork(void)
     child_tcb -> registers.eax = 0;
     parent_tcb -> registers.eax = child_pcb -> pid;
     list_init(&child_pcb -> threads);
-    list_init(&child_pcb -> va);
+    if (region_copy(child_pcb, parent_pcb) < 0)
+    {
+        fork_undo(child_pcb, child_tcb, reserved);
+        return -1;
+    }
+    // unloaded pages of the image are loaded from the same executable
+    child_pcb -> image = parent_pcb -> image;
     list_insert_last(&child_pcb -> threads, &child_tcb->peer_threads_node);
     lprintf("The length is %d",child_pcb->threads.length);
     /* step 4: set up the process control block */
     list_init(&child_pcb -> children);
+    wq_init(&child_pcb -> exit_waiters);
     child_pcb -> pid = next_pid;
     next_pid++;
     child_pcb -> state = PROCESS_RUNNING;
     child_pcb -> parent = parent_pcb;
-    list_insert_last(&parent_pcb -> children, &child_pcb->peer_processes_node);
-    parent_pcb -> children_count++;
 
     /* step 5: create a new page directory for the child */
     child_pcb -> PD = (uint32_t *) memalign(PD_SIZE * 4, PT_SIZE * 4);
     if (child_pcb -> PD == NULL)
     {
+        fork_undo(child_pcb, child_tcb, reserved);
         return -1;
     }
+    // fork_undo walks the whole directory if a page table cannot be had
+    memset(child_pcb -> PD, 0, PD_SIZE * 4);
     //lprintf("The child tid is %d, pd is %p", child_tcb->tid, child_tcb->pcb->PD);
     int i, j;
     // copy kernel mappings first
@@ -164,75 +203,65 @@ int sys_fork(void)
     {
         (child_pcb->PD)[i] = parent_directory[i];
     }
-    // copy user mappings by allocating new frames for each mapping
+    // share user mappings copy-on-write instead of copying frames
     for (i = 4; i < PD_SIZE; ++i)
     {
         //parent directory entry info
         uint32_t parent_de_raw = parent_directory[i];
         uint32_t pt_addr = DEFLAG_ADDR(parent_de_raw);
-        if (pt_addr == 0)  continue;
+        if (pt_addr == 0)
+        {
+            (child_pcb->PD)[i] = 0;
+            continue;
+        }
         //child direcotory entry info
         uint32_t child_de = (uint32_t)memalign(PT_SIZE * 4, PT_SIZE * 4);
         if (child_de ==0)
         {
+            fork_undo(child_pcb, child_tcb, reserved);
             return -1;
         }
         uint32_t child_de_raw = ADDFLAG(child_de, (GET_FLAG(parent_de_raw)));
         (child_pcb->PD)[i] = child_de_raw;
-        //copy page table enties, and copy frame data
+        //copy page table entries, both sides lose write permission
         for (j = 0; j < PT_SIZE; ++j)
         {
-
             //page table entry info
             uint32_t phys_addr_raw = ((uint32_t *)pt_addr) [j];
             uint32_t phys_addr = DEFLAG_ADDR(phys_addr_raw);
-            if (phys_addr == 0)  continue;
-            if (j == 1 && i == 1023)
+            if (IS_LAZY_PTE(phys_addr_raw))
             {
-                //lprintf("This is speicial case");
-                // MAGIC_BREAK;
+                // already reserved above
+                ((uint32_t *)child_de) [j] = phys_addr_raw;
+                reserved--;
+                continue;
             }
-            uint32_t parent_entry_v_addr = (i << 22) | (j << 12);
-            //lprintf("page table entry: %d",j);
-            int result = virtual_map_physical(parent_directory, entry.pd_index,
-                                 entry.pt_index);
-            if (result == -1)
+            if (phys_addr == 0)
             {
-                return -1;
+                ((uint32_t *)child_de) [j] = 0;
+                continue;
             }
-            uint32_t found_table = DEFLAG_ADDR(parent_directory[entry.pd_index]);
-            //new allocated frame address with flags;
-            uint32_t new_phys_addr = ((uint32_t *)found_table)[entry.pt_index];
-            //copy the physical frame using virtual address
-            //so that we don't need to turn off paging
-            //lprintf("start copying physical addr!");
-            //lprintf("free_virtual_addr: %x",(int)entry.free_virtual_addr);
-            //lprintf("i:%d",i);
-            //lprintf("j:%d",j);
-            //lprintf("pd_index: %d",entry.pd_index);
-            //lprintf("pt_index: %d",entry.pt_index);
-            //lprintf("parent entry virtual addr: %x",(int)parent_entry_v_addr);
-            //lprintf("old physical addr:%x",(unsigned int) phys_addr);
-            //lprintf("new physical addr:%x",(unsigned int) DEFLAG_ADDR(new_phys_addr));
-            memcpy((void *)entry.free_virtual_addr, (void *)parent_entry_v_addr, 4096);
-            //demap this new frame from parent pd
-            ((uint32_t *)child_de) [j] = ADDFLAG(DEFLAG_ADDR(new_phys_addr), GET_FLAG(phys_addr_raw)) ;
-            bzero( &(((uint32_t *)found_table) [entry.pt_index])  , 4);
-            // ((uint32_t*)found_table) [entry.pt_index] = 0;
-
-            //and map this new frame to child pd;
-
-            //lprintf("child_de pte:%x",(unsigned int) ((uint32_t*)child_de) [j]);
-            //lprintf("hahah: %x", (int)(((uint32_t*)found_table) [entry.pt_index]));
-            set_cr3((uint32_t)parent_directory);
+            if (phys_addr_raw & PTE_RW)
+            {
+                phys_addr_raw = (phys_addr_raw & ~PTE_RW) | PTE_COW;
+                ((uint32_t *)pt_addr) [j] = phys_addr_raw;
+            }
+            share_frame(phys_addr);
+            ((uint32_t *)child_de) [j] = phys_addr_raw;
         }
     }
+    // parent's writable pages are now read-only, drop stale TLB entries
+    set_cr3((uint32_t)parent_directory);
 
     // //lprintf("finished!");
 
     // insert child to the list of threads and processes
+    list_insert_last(&parent_pcb -> children, &child_pcb->peer_processes_node);
+    parent_pcb -> children_count++;
     list_insert_last(&process_queue, &child_pcb->all_processes_node);
-    list_insert_last(&runnable_queue, &child_tcb->thread_list_node);
+    process_register(child_pcb);
+    thr_register(child_tcb);
+    runq_insert(child_tcb);
     // list_insert_last(&thread_queue, &parent_tcb->all_threads);
 
     // lprintf("ready to return! parent pid:%d", parent_pcb -> pid);
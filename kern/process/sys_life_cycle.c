@@ -22,7 +22,13 @@
 #include "locks/mutex_type.h"
 #include "simics.h"
 #include "memory/vm_routines.h"
+#include "memory/region.h"
+#include "memory/usercopy.h"
 #include "scheduler.h"
+#include "process.h"
+#include "thread/thread_basic.h"
+#include "hardware/fpu.h"
+#include <x86/asm.h>
 
 /** @brief Determine if the given queue is empty
  *
@@ -57,11 +63,20 @@ int sys_thread_fork(void)
 
     TCB *child_tcb = (TCB *)malloc(sizeof(TCB));
 
+    mutex_init(&child_tcb -> tcb_mutex);
     child_tcb -> pcb = parent_pcb;
     child_tcb -> tid = next_tid;
     next_tid++;
 
     child_tcb -> state = THREAD_INIT;
+    child_tcb -> priority = child_tcb -> base_priority =
+        current_thread -> base_priority;
+    child_tcb -> runq_level = -1;
+    child_tcb -> slice_left = TIME_SLICE;
+    list_init(&child_tcb -> held_mutexes);
+    child_tcb -> blocked_on = NULL;
+    child_tcb -> waiting_in = NULL;
+    child_tcb -> fpu_state = NULL;
     /*each thread has its own kernle stack*/
     child_tcb -> stack_size = current_thread -> stack_size;
     child_tcb -> stack_base = memalign(4, child_tcb -> stack_size);
@@ -74,7 +89,8 @@ int sys_thread_fork(void)
 
     // Insert this child thread into runnable queue and parent's thread queue
     list_insert_last(&threads, &child_tcb->peer_threads_node);
-    list_insert_last(&runnable_queue, &child_tcb->thread_list_node);
+    thr_register(child_tcb);
+    runq_insert(child_tcb);
 
     return child_tcb -> tid;
 }
@@ -137,8 +153,11 @@ void sys_vanish(void)
             {
                 // Remove this child thread from all kinds of queues
                 list_delete(&threads, n);
-                list_delete(&blocked_queue, n);
-                list_delete(&runnable_queue, n);
+                wq_remove(tcb);
+                runq_delete(tcb);
+                sleep_cancel(tcb);
+                thr_unregister(tcb);
+                fpu_release(tcb);
 
                 // Free its kernel stack and tcb
                 sfree(tcb -> stack_base, tcb -> stack_size);
@@ -150,6 +169,7 @@ void sys_vanish(void)
         mutex_lock(&process_queue_lock);
         list_delete(&process_queue, &current_pcb -> all_processes_node);
         mutex_unlock(&process_queue_lock);
+        process_unregister(current_pcb);
         PCB *parent = current_pcb -> parent;
 
         /* If the parent has already exited or doesn't exit, wake up
@@ -159,33 +179,11 @@ void sys_vanish(void)
 
             lprintf(" report the state to init");
             // MAGIC_BREAK;
-            TCB *init = NULL;
-            for (n = list_begin(&blocked_queue);
-                    n != NULL;
-                    n = n -> next)
+            PCB *init = process_lookup(INIT_PID);
+            if (init != NULL)
             {
-                init = list_entry(n, TCB, thread_list_node);
-                if (init -> tid == 2)
-                {
-                    lprintf("Find init and make it runnable");
-
-                    mutex_lock(&blocked_queue_lock);
-                    list_delete(&blocked_queue, &init->thread_list_node);
-                    mutex_unlock(&blocked_queue_lock);
-
-                    mutex_lock(&init -> tcb_mutex);
-                    init -> state = THREAD_RUNNABLE;
-                    mutex_unlock(&init -> tcb_mutex);
-
-                    mutex_lock(&runnable_queue_lock);
-                    list_insert_last(&runnable_queue, &init->thread_list_node);
-                    mutex_unlock(&runnable_queue_lock);
-                    break;
-                }
-
-
-
-
+                lprintf("Find init and make it runnable");
+                wq_wake_one(&init -> exit_waiters);
             }
 
         }
@@ -195,38 +193,15 @@ void sys_vanish(void)
                Find a thread that waits to reap this process(thread)
                because we can ensure that there is only one thread left
                for this process */
-            list parent_threads = parent -> threads;
-            TCB *waiting_thread = NULL;
-            for (n = list_begin(&parent_threads);
-                    n != NULL;
-                    n = n -> next)
-            {
-                waiting_thread = list_entry(n, TCB, peer_threads_node);
-                // If we find a thread that is waiting, we delete it from the waiting
-                // queue and make it runnable
-
-                if (waiting_thread -> state == THREAD_WAITING)
-                {
-                    lprintf("I have found a parent %dthat is waiting me", waiting_thread->tid);
-                    mutex_lock(&blocked_queue_lock);
-                    list_delete(&blocked_queue, &waiting_thread->thread_list_node);
-                    mutex_unlock(&blocked_queue_lock);
-
-                    mutex_lock(&waiting_thread -> tcb_mutex);
-                    waiting_thread -> state = THREAD_RUNNABLE;
-                    mutex_unlock(&waiting_thread -> tcb_mutex);
-
-                    mutex_lock(&runnable_queue_lock);
-                    list_insert_last(&runnable_queue, &waiting_thread->thread_list_node);
-                    mutex_unlock(&runnable_queue_lock);
-                    break;
-                }
-            }
+            lprintf("wake up a thread of %d that waits for me", parent -> pid);
+            wq_wake_one(&parent -> exit_waiters);
         }
 
     }
-    // Set the current state to be exit
+    // Set the current state to be exit, the tid is no longer valid
     current_thread -> state = THREAD_EXIT;
+    thr_unregister(current_thread);
+    fpu_release(current_thread);
 
     mutex_unlock(&current_thread -> tcb_mutex);
     lprintf("(x_x)_vanish called schedule %d", current_thread -> tid);
@@ -235,102 +210,86 @@ void sys_vanish(void)
 
 }
 
-/** @brief Determine if the given queue is empty
+/** @brief Find an exited child of a process
  *
- *  If top == bottom, we know there are nothing in the queue.
+ *  @param pcb the process
+ *  @return the child, NULL if none of its children has exited yet
+ **/
+static PCB *find_exited_child(PCB *pcb)
+{
+    node *n;
+    for (n = list_begin(&pcb -> children); n != NULL; n = n -> next)
+    {
+        PCB *child = list_entry(n, PCB, peer_processes_node);
+        if (child -> state == PROCESS_EXIT) return child;
+    }
+    return NULL;
+}
+
+/** @brief Wait for a child to exit and reap it
  *
- *  @param q The pointer to the queue
- *  @return int 1 means not empty and 0 otherwise
+ *  Looking for an exited child and queueing up in exit_waiters happen
+ *  in one section with interrupts disabled, so a child that vanishes
+ *  in between cannot wake up nobody. The child is taken off the list
+ *  in that section too, so two waiting threads never reap the same
+ *  child.
+ *
+ *  @param status_ptr where the exit status of the child goes, may be
+ *         NULL
+ *  @return the pid of the child, -1 if there is no child left to wait
+ *          for or status_ptr is not writable, in which case no child
+ *          is reaped
  **/
 int sys_wait(int *status_ptr)
 {
-    if (status_ptr != NULL && !is_user_addr(status_ptr)) return -1;
+    if (status_ptr != NULL && !user_writable(status_ptr, sizeof(int)))
+        return -1;
 
     PCB *current_pcb = current_thread -> pcb;
-    list *child_pros = &current_pcb -> children;
-    lprintf("Note that %d has %d children", current_thread->tid, current_pcb -> children_count);
+    PCB *pcb;
 
-    // If this process has no forked children, kernel don't let it wait
-    if (current_pcb -> children_count == 0)
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    while ((pcb = find_exited_child(current_pcb)) == NULL)
     {
-        lprintf("%d, You can't wait", current_thread->tid);
-        return -1;
-    }
-    node *n;
-
-    for (n = list_begin (child_pros); n != NULL; n = n -> next)
-    {
-        PCB *pcb = list_entry(n, PCB, peer_processes_node);
-        // Found one already exited child
-        if (pcb -> state == PROCESS_EXIT)
+        // If this process has no children left, kernel don't let it wait
+        if (current_pcb -> children_count == 0)
         {
-            int pid = pcb -> pid;
-            // collects the return status
-            if (status_ptr != NULL)
-            {
-                *status_ptr = pcb -> return_state;
-            }
-            // Reap this child
-            lprintf("Reap this child %d", pid);
-            list_delete(child_pros, &pcb -> peer_processes_node);
-            current_pcb -> children_count--;
-
-            // Free all of its physical page mappings
-            destroy_page_directory(pcb -> PD);
-
-            // Free page directory
-            sfree(pcb -> PD, 4096);
-
-            // Free control block
-            free(pcb);
-            return pid;
+            set_eflags(eflags);
+            return -1;
         }
+        // Returns with interrupts disabled again
+        wq_wait(&current_pcb -> exit_waiters, THREAD_WAITING);
     }
-    // If no child_pros is exited, wait till one of them exits
-    mutex_lock(&current_thread -> tcb_mutex);
-    current_thread -> state = THREAD_WAITING;
-    mutex_unlock(&current_thread -> tcb_mutex);
-    lprintf("Not available, i %d call schedule", current_thread->tid);
-    schedule(-1);
-    lprintf("Someone wakes me %d up", current_thread->tid);
-
-
-    // Do the thing again once one exited child wake me up
-    for (n = list_begin (child_pros); n != NULL; n = n -> next)
+    list_delete(&current_pcb -> children, &pcb -> peer_processes_node);
+    current_pcb -> children_count--;
+    set_eflags(eflags);
+
+    int pid = pcb -> pid;
+    // collects the return status, a sibling thread may have removed the
+    // page since the check, then the child stays for a later wait
+    if (status_ptr != NULL &&
+        copy_to_user(status_ptr, &pcb -> return_state, sizeof(int)) < 0)
     {
-        PCB *pcb = list_entry(n, PCB, peer_processes_node);
-        // Found one already exited child
-        if (pcb -> state == PROCESS_EXIT)
-        {
-            int pid = pcb -> pid;
-            // collects the return status
-            if (status_ptr != NULL)
-            {
-                *status_ptr = pcb -> return_state;
-            }
-            // Reap this child
-            lprintf("Reap the child after schedule");
-            list_delete(child_pros, &pcb -> peer_processes_node);
-            current_pcb -> children_count--;
-            for (n = list_begin (&runnable_queue);
-                    n != NULL;
-                    n = n -> next)
-            {
-                // TCB *tcb = list_entry(n, TCB, thread_list_node);
-                // lprintf("The tid in the runnable_queue is %d", tcb->tid);
-            }
-
-            // Free all of its physical page mappings
-            destroy_page_directory(pcb -> PD);
+        disable_interrupts();
+        list_insert_last(&current_pcb -> children,
+                         &pcb -> peer_processes_node);
+        current_pcb -> children_count++;
+        wq_wake_one(&current_pcb -> exit_waiters);
+        set_eflags(eflags);
+        return -1;
+    }
+    // Reap this child
+    lprintf("Reap this child %d", pid);
 
-            // Free page directory
-            sfree(pcb -> PD, 4096);
+    // Free all of its physical page mappings
+    destroy_page_directory(pcb -> PD);
+    region_destroy(pcb);
 
-            // Free control block
-            free(pcb);
-            return pid;
-        }
-    }
-    return -1;
+    // Free page directory
+    sfree(pcb -> PD, 4096);
 
+    // Free control block
+    free(pcb);
+    return pid;
 }
\ No newline at end of file
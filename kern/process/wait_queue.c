@@ -0,0 +1,100 @@
+/** @file wait_queue.c
+ *
+ *  @brief This file implements wait queues. A waiting thread remembers
+ *         its queue, so it can be taken out directly when it is woken up
+ *         by tid or reaped. Queues are changed with interrupts disabled
+ *         since interrupt handlers wake threads up.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#include "control_block.h"
+#include "wait_queue.h"
+#include "scheduler.h"
+#include <x86/asm.h>
+#include <eflags.h>
+#include <stddef.h>
+
+/** @brief Initialize an empty wait queue
+ *
+ *  @param wq the wait queue
+ *  @return void
+ **/
+void wq_init(wait_queue *wq)
+{
+    list_init(&wq -> waiters);
+}
+
+/** @brief Block the current thread at the tail of a wait queue
+ *
+ *  Queueing and switching away happen with interrupts disabled, so a
+ *  wake up cannot get lost in between.
+ *
+ *  @param wq the wait queue
+ *  @param state the blocked state the thread is in while it waits
+ *  @return void, once the thread is woken up
+ **/
+void wq_wait(wait_queue *wq, int state)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    current_thread -> state = state;
+    current_thread -> waiting_in = wq;
+    list_insert_last(&wq -> waiters, &current_thread -> thread_list_node);
+    schedule(-1);
+    set_eflags(eflags);
+}
+
+/** @brief Take a thread out of the wait queue it waits in, if any,
+ *         without making it runnable, used when it is reaped
+ *
+ *  @param tcb the thread
+ *  @return void
+ **/
+void wq_remove(TCB *tcb)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    if (tcb -> waiting_in != NULL)
+    {
+        list_delete(&tcb -> waiting_in -> waiters, &tcb -> thread_list_node);
+        tcb -> waiting_in = NULL;
+    }
+    set_eflags(eflags);
+}
+
+/** @brief Make a waiting thread runnable
+ *
+ *  @param tcb the thread, must be waiting in a wait queue
+ *  @return void
+ **/
+void wq_wake(TCB *tcb)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    wq_remove(tcb);
+    tcb -> state = THREAD_RUNNABLE;
+    runq_insert_woken(tcb);
+    set_eflags(eflags);
+}
+
+/** @brief Make the thread that has waited the longest runnable
+ *
+ *  @param wq the wait queue
+ *  @return the thread woken up, NULL if nobody was waiting
+ **/
+TCB *wq_wake_one(wait_queue *wq)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    TCB *tcb = NULL;
+    if (wq -> waiters.length != 0)
+    {
+        tcb = list_entry(list_begin(&wq -> waiters), TCB, thread_list_node);
+        wq_wake(tcb);
+    }
+    set_eflags(eflags);
+    return tcb;
+}
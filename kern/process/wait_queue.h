@@ -0,0 +1,35 @@
+/**
+ * @file wait_queue.h
+ *
+ * @brief A queue of threads blocked for the same reason, such as a line
+ *        of console input or the exit of a child. Waking a thread up is
+ *        a queue pop instead of a search of all blocked threads.
+ *
+ * @author Xianqi Zeng (xianqiz)
+ * @author Tianyuan Ding (tding)
+ *
+ */
+
+#ifndef _WAIT_QUEUE_H
+#define _WAIT_QUEUE_H
+
+#include "datastructure/linked_list.h"
+
+struct TCB_t;
+
+typedef struct wait_queue_t
+{
+    list waiters;       // Linked through thread_list_node, in FIFO order
+} wait_queue;
+
+void wq_init(wait_queue *wq);
+
+void wq_wait(wait_queue *wq, int state);
+
+struct TCB_t *wq_wake_one(wait_queue *wq);
+
+void wq_wake(struct TCB_t *tcb);
+
+void wq_remove(struct TCB_t *tcb);
+
+#endif /* _WAIT_QUEUE_H */
@@ -8,76 +8,67 @@
 #include <asm.h>
 #include "process/scheduler.h"
 #include "memory/vm_routines.h"
+#include "memory/usercopy.h"
+#include <malloc.h>
 
 #define MAX_READ_LEN 4096  // Default buffer length, to hold 512 scan codes in a queue
+#define MAX_PRINT_LEN (80 * 25 * 16)  // Bound a single print request
+
+#define LEN_MIN(x,y) ((x) < (y) ? (x) : (y))
+
+// Kernel copy of the bytes being printed, protected by print_lock
+static char print_buffer[PAGE_SIZE];
 
 int sys_readline(int len, char *buf)
 {
+    if (len < 0 || len > MAX_READ_LEN) return -1;
+    if (len == 0) return 0;
+    // Fail early if the buffer cannot take the line
     if (!is_user_addr(buf) || !addr_has_mapping(buf)) return -1;
-    if (len > MAX_READ_LEN) return -1;
-    mutex_lock(&current_thread -> tcb_mutex);
-    current_thread -> state = THREAD_READLINE;
-    mutex_unlock(&current_thread -> tcb_mutex);
-    schedule(-1);
+    // The line is collected in the kernel and copied out once
+    char *line = (char *)malloc(len);
+    if (line == NULL) return -1;
+    // The keyboard handler wakes one reader up per line
+    wq_wait(&console_readers, THREAD_READLINE);
     disable_interrupts();
-    lprintf("in readline again");
-    lprintf("the total num is %d", total_num);
-    lprintf("the len is %d", len);
-    if (len < 0)  // verify buf
-	{
-		return -1;
-	}
     int count = 0;
-	char c;
-    lprintf("very original count is: %d",count);
-    while ((c = readchar()) != -1) 
+    char c;
+    while (count < len && (c = readchar()) != -1)
     {
-        lprintf("i have read %c",c);
-        buf[count] = c;
-        count ++;
-        lprintf("original count is: %d",count);
-
-        if (c == '\b') {
-            lprintf("this is bbb");
-            count --;
+        if (c == '\b')
+        {
             if (count > 0) count--;
+            continue;
         }
-
-        if (count == len) {
-            lprintf("wtf");
-            buf[count-1] = '\0';
-            break;
-        }
-        
-        if (c == '\n') {
-            lprintf("this is nnn");
-            buf[count-1] = '\n';
-            break;
-        }
+        line[count++] = c;
+        if (c == '\n') break;
     }
-    // MAGIC_BREAK;
-    lprintf("readline done, the buf: %s",buf);
     total_num = total_num - count;
-    lprintf("the total num is %d", total_num);
     enable_interrupts();
 
-    return count;
+    int result = copy_to_user(buf, line, count);
+    free(line);
+    return result < 0 ? -1 : count;
 }
 
 int sys_print(int len, char *buf)
 {
+    if (len < 0 || len > MAX_PRINT_LEN) return -1;
     mutex_lock(&print_lock);
     lprintf("len is: %d",len);
-    lprintf("strlen is: %d",strlen(buf));
-    lprintf("buf is: %s",buf);
-	// if (len < 0 || len != strlen(buf) || len > 80*25) // and verify buf
-	// {
-	// 	return -1;
-	// }
-    if (!is_user_addr(buf) || !addr_has_mapping(buf)) return -1;
-
-    putbytes(buf, len);
-    // bzero(buf, len);
+    // Copy in one chunk at a time, the print lock protects the buffer
+    int done = 0;
+    while (done < len)
+    {
+        int chunk = LEN_MIN(len - done, PAGE_SIZE);
+        if (copy_from_user(print_buffer, buf + done, chunk) < 0)
+        {
+            mutex_unlock(&print_lock);
+            return -1;
+        }
+        putbytes(print_buffer, chunk);
+        done += chunk;
+    }
     mutex_unlock(&print_lock);
     return 0;
 }
@@ -89,9 +80,10 @@ int sys_print(int len, char *buf)
 
 int sys_get_cursor_pos(int *row, int *col)
 {
-    if (!is_user_addr(row) || !addr_has_mapping(row)) return -1;
-    if (!is_user_addr(col) || !addr_has_mapping(col)) return -1;   
-    get_cursor(row, col);
+    int cur_row, cur_col;
+    get_cursor(&cur_row, &cur_col);
+    if (copy_to_user(row, &cur_row, sizeof(int)) < 0) return -1;
+    if (copy_to_user(col, &cur_col, sizeof(int)) < 0) return -1;
     return 0;
 }
 
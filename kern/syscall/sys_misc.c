@@ -6,6 +6,8 @@
 #include <string.h>
 #include <exec2obj.h>
 #include "memory/vm_routines.h"
+#include "memory/usercopy.h"
+#include "hardware/timer.h"
 
 #define LEN_MIN(x,y) ((x) < (y) ? (x) : (y))
 
@@ -20,6 +22,10 @@ void sys_halt(void)
 {
 	clear_console();        
     lprintf("Shutting down...");
+    lprintf("zero pool: %u hits, %u misses", zero_pool_hits, zero_pool_misses);
+    lprintf("idle for %u of %u ticks", idle_ticks, sys_get_ticks());
+    lprintf("context switches: %u in the same address space, %u across",
+            switches_same_space, switches_cross_space);
     sim_halt();
 
     // TODO power off
@@ -33,8 +39,9 @@ int sys_readfile(char *filename, char *buf, int size, int offset)
 	// lprintf("I am readfile! buf: %s",buf);
 	// lprintf("I am readfile! size: %d",size);
 	// lprintf("I am readfile! offset: %d",offset);
-    if (!is_user_addr(filename) || !addr_has_mapping(filename)) return -1;   
-    if (!is_user_addr(buf) || !addr_has_mapping(buf)) return -1;   
+	char name[MAX_EXECNAME_LEN];
+	if (copy_string_from_user(name, filename, MAX_EXECNAME_LEN) < 0)
+		return -1;
 
 	if (size < 0 || offset < 0)
 	{
@@ -48,7 +55,7 @@ int sys_readfile(char *filename, char *buf, int size, int offset)
     for (i = 0; i < exec2obj_userapp_count; i++)
     {   
         // If we find this filename
-        if (!strcmp(exec2obj_userapp_TOC[i].execname , filename))
+        if (!strcmp(exec2obj_userapp_TOC[i].execname , name))
         {
         	real_starting_point = (char*)(
         					    (unsigned int)exec2obj_userapp_TOC[i].execbytes 
@@ -56,8 +63,8 @@ int sys_readfile(char *filename, char *buf, int size, int offset)
         	realsize = LEN_MIN(size,exec2obj_userapp_TOC[i].execlen - offset);
             if (realsize < 0) return -1;
             // realsize = 200;
-            memcpy(buf, (void*)real_starting_point,realsize);
-        	lprintf("the real string is: %s", real_starting_point);
+            if (copy_to_user(buf, real_starting_point, realsize) < 0)
+                return -1;
             lprintf("found a file. its length is: %d",realsize+1);
             return realsize;
         }
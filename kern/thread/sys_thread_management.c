@@ -2,7 +2,8 @@
  *
  *  @brief This file includes implementation of some of the
  *         thread management system calls:
-           gettid, deschedule, make_runnable, get_ticks and sleep
+           gettid, deschedule, make_runnable, set_priority, get_ticks
+           and sleep
  *
  *  @author Xianqi Zeng (xianqiz)
  *  @author Tianyuan Ding (tding)
@@ -14,14 +15,17 @@
 #include "control_block.h"
 #include "locks/mutex_type.h"
 #include "process/scheduler.h"
+#include "thread_basic.h"
 #include "hardware/timer.h"
 #include "handler_install.h"
 #include "seg.h"
 #include "simics.h"
 #include <ureg.h>
 #include <eflags.h>
+#include <x86/asm.h>
 #include <cr.h>
 #include "memory/vm_routines.h"
+#include "memory/usercopy.h"
 
 
 #define ALLOWED_BITS    (EFL_CF | EFL_PF | EFL_AF | EFL_ZF | EFL_SF | \
@@ -50,60 +54,22 @@ int sys_yield(int tid)
     {
         lprintf("(x_x)_inside yeild");
 
-        // If the target thread is blocked
-        mutex_lock(&blocked_queue_lock);
-        node *n;
-        for (n = list_begin(&blocked_queue);
-                n != NULL;
-                n = n -> next)
+        // The target must exist, be someone else and be runnable, which
+        // must still hold when the scheduler looks for it
+        uint32_t eflags = get_eflags();
+        disable_interrupts();
+        TCB *target = thr_lookup(tid);
+        if (target == NULL || target == current_thread ||
+            target -> runq_level < 0)
         {
-            TCB *tcb = list_entry(n, TCB, thread_list_node);
-            if (tcb -> tid == tid)
-            {
-                lprintf("(x_x)_yield to a blocked thread");
-                mutex_unlock(&blocked_queue_lock);
-
-                return -1;
-            }
-        }
-        mutex_unlock(&blocked_queue_lock);
-
-        // If try to yield to itself
-        mutex_lock(&current_thread -> tcb_mutex);
-        if (current_thread -> tid == tid)
-        {
-            lprintf("(x_x)_yield to itself");
-
-            mutex_unlock(&current_thread -> tcb_mutex);
-            return -1;
-        }
-        mutex_unlock(&current_thread -> tcb_mutex);
-
-
-        // If the target thread does not exit
-        int exist = 0;
-        mutex_lock(&runnable_queue_lock);
-        for (n = list_begin (&runnable_queue);
-                n != NULL;
-                n = n -> next)
-        {
-            TCB *tcb = list_entry(n, TCB, thread_list_node);
-            if (tcb -> tid == tid)
-            {
-                exist = 1;
-                break;
-            }
-        }
-        mutex_unlock(&runnable_queue_lock);
-        if (!exist)
-        {
-            lprintf("(x_x)_doesn't exist");
-
+            lprintf("(x_x)_cannot yield to %d", tid);
+            set_eflags(eflags);
             return -1;
         }
         lprintf("(x_x)_schedule in yield");
         // Finally, tid is valid, we schedule to this thread
         schedule(tid);
+        set_eflags(eflags);
     }
 
     return 0; // can return back here?
@@ -118,24 +84,24 @@ int sys_yield(int tid)
  **/
 int sys_deschedule(int *reject)
 {
-    if (!is_user_addr(reject) || !addr_has_mapping(reject)) return -1;
+    int reject_value;
     mutex_lock(&deschedule_lock);
     // Check reject pointer
-    if (*reject != 0)
+    if (copy_from_user(&reject_value, reject, sizeof(int)) < 0)
+    {
+        mutex_unlock(&deschedule_lock);
+        return -1;
+    }
+    if (reject_value != 0)
     {
         mutex_unlock(&deschedule_lock);
         return 0;
     }
-    // atomicity??
-    mutex_lock(&current_thread -> tcb_mutex);
-    // Set status to blocked
-    current_thread -> state = THREAD_BLOCKED;
-    mutex_unlock(&current_thread -> tcb_mutex);
-
-    // Call the scheduler
+    // Call the scheduler, which releases deschedule_lock once we are
+    // queued
     lprintf("(x_x)_deschedule call schedule");
 
-    schedule(-1);
+    wq_wait(&descheduled_threads, THREAD_BLOCKED);
 
     return 0;
 }
@@ -156,71 +122,62 @@ int sys_make_runnable(int tid)
         return -1;
     }
 
-    node *n;
-    // Find if the target is runnable, if so, return -1
-    mutex_lock(&runnable_queue_lock);
-    for (n = list_begin (&runnable_queue); n != NULL; n = n -> next)
-    {
-        TCB *tcb = list_entry(n, TCB, thread_list_node);
-        if (tcb -> tid == tid)
-        {
-            if (tcb -> state == THREAD_RUNNABLE)
-            {
-                mutex_unlock(&runnable_queue_lock);
-                lprintf("sys_make_runnable:[ohoh, it's runnable]");
-                return -1;
-            }
-        }
-    }
-    mutex_unlock(&runnable_queue_lock);
-    lprintf("143");
-    // If the target thread is blocked and exist
-    int exist = 0;
-    TCB *target = NULL;
-    mutex_lock(&blocked_queue_lock);
-    for (n = list_begin(&blocked_queue); n != NULL; n = n -> next)
-    {
-        target = list_entry(n, TCB, thread_list_node);
-        if (target -> tid == tid && target -> state == THREAD_BLOCKED)
-        {
-
-            exist = 1;
-            break;
-        }
-    }
-    mutex_unlock(&blocked_queue_lock);
-    lprintf("159");
-
-    if (!exist)
+    // Only a thread blocked by deschedule can be made runnable. Holding
+    // deschedule_lock, it is in the blocked queue by now if it is blocked
+    mutex_lock(&deschedule_lock);
+    TCB *target = thr_lookup(tid);
+    if (target == NULL || target -> state != THREAD_BLOCKED)
     {
-        lprintf("sys_make_runnable[ohoh, it doens't exist]");
-
+        mutex_unlock(&deschedule_lock);
+        lprintf("sys_make_runnable[ohoh, %d is not descheduled]", tid);
         return -1;
     }
-    lprintf("167");
 
-    mutex_lock(&deschedule_lock);
+    // Take it out of descheduled_threads and into a run queue
+    wq_wake(target);
 
-    // Make the target thread runnable
-    mutex_lock(&target -> tcb_mutex);
-    target -> state = THREAD_RUNNABLE;
-    mutex_unlock(&target -> tcb_mutex);
+    mutex_unlock(&deschedule_lock);
 
-    // Remove the target out of the blocked queue
-    mutex_lock(&blocked_queue_lock);
-    list_delete(&blocked_queue, &target->thread_list_node);
-    mutex_unlock(&blocked_queue_lock);
 
+    lprintf("(x_x)_now make runnable");
+    return 0;
+}
 
-    // Insert the target into the runnable queue
-    mutex_lock(&runnable_queue_lock);
-    list_insert_last(&runnable_queue, &target->thread_list_node);
-    mutex_unlock(&runnable_queue_lock);
 
-    mutex_unlock(&deschedule_lock);
+/** @brief Change the scheduling priority of a thread
+ *
+ *  The thread is looked up and moved between run queues with interrupts
+ *  disabled, so it cannot change state meanwhile. The scheduler is then
+ *  invoked, in case a thread now has a higher priority than the caller.
+ *
+ *  A task may only change the priorities of its own threads, so it
+ *  cannot starve or boost other tasks.
+ *
+ *  @param tid a thread of the calling task
+ *  @param priority between PRIORITY_HIGHEST and PRIORITY_LOWEST
+ *  @return 0 on success, -1 if the priority is out of range or there is
+ *          no such thread in the calling task
+ **/
+int sys_set_priority(int tid, int priority)
+{
+    if (priority < PRIORITY_HIGHEST || priority > PRIORITY_LOWEST ||
+        tid == IDLE_TID)
+        return -1;
 
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    TCB *target = thr_lookup(tid);
+    if (target == NULL || target -> pcb != current_thread -> pcb)
+    {
+        set_eflags(eflags);
+        return -1;
+    }
+    // A priority lent by mutex waiters stays until the mutex is unlocked
+    target -> base_priority = priority;
+    runq_set_priority(target, mutex_inherited_priority(target));
+    set_eflags(eflags);
 
-    lprintf("(x_x)_now make runnable");
+    schedule(-1);
     return 0;
 }
 
@@ -262,8 +219,7 @@ int sys_sleep(int ticks)
     else
     {
         mutex_lock(&current_thread -> tcb_mutex);
-        current_thread -> duration = ticks;
-        current_thread -> start_ticks = sys_get_ticks();
+        current_thread -> sleep_node.key = sys_get_ticks() + ticks;
         current_thread -> state = THREAD_SLEEPING;
         mutex_unlock(&current_thread -> tcb_mutex);
 
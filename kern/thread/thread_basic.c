@@ -18,6 +18,9 @@
 #include "eflags.h"
 #include "locks/mutex_type.h"
 #include "thread_basic.h"
+#include "process/scheduler.h"
+#include "locks/futex.h"
+#include <x86/asm.h>
 
 /** @brief Release a frame frame and mark it as freed only when refcount = 0.
  *         If so, let free_frame point to it.
@@ -28,14 +31,60 @@
  **/
 void thr_init()
 {
-    list_init(&runnable_queue);
-    list_init(&blocked_queue);
-    mutex_init(&blocked_queue_lock);
+    runq_init();
+    wq_init(&descheduled_threads);
+    wq_init(&console_readers);
+    futex_init();
     mutex_init(&runnable_queue_lock);
     mutex_init(&deschedule_lock);
+    hash_init(&tid_table);
     next_tid = 1;
 }
 
+/** @brief Make a thread findable by its tid
+ *
+ *  @param tcb the thread, its tid must be set
+ *  @return void
+ **/
+void thr_register(TCB *tcb)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    tcb -> tid_node.key = tcb -> tid;
+    hash_insert(&tid_table, &tcb -> tid_node);
+    set_eflags(eflags);
+}
+
+/** @brief Forget the tid of a thread that vanished or is being freed
+ *
+ *  @param tcb the thread, nothing happens if it is not registered
+ *  @return void
+ **/
+void thr_unregister(TCB *tcb)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    hash_delete(&tid_table, &tcb -> tid_node);
+    set_eflags(eflags);
+}
+
+/** @brief Find a live thread by its tid
+ *
+ *  Call it with interrupts disabled if the thread must not vanish while
+ *  it is being used.
+ *
+ *  @param tid the tid
+ *  @return the thread, NULL if no live thread has that tid
+ **/
+TCB *thr_lookup(int tid)
+{
+    uint32_t eflags = get_eflags();
+    disable_interrupts();
+    hash_node *n = hash_find(&tid_table, tid);
+    set_eflags(eflags);
+    return (n == NULL) ? NULL : hash_entry(n, TCB, tid_node);
+}
+
 /** @brief Release a frame frame and mark it as freed only when refcount = 0.
  *         If so, let free_frame point to it.
  *
@@ -53,6 +102,14 @@ TCB *thr_create(unsigned int eip, int run)
     mutex_init(&tcb -> tcb_mutex);
 
     tcb -> state = THREAD_RUNNING;
+    tcb -> priority = tcb -> base_priority = PRIORITY_DEFAULT;
+    tcb -> runq_level = -1;
+    tcb -> slice_left = TIME_SLICE;
+    list_init(&tcb -> held_mutexes);
+    tcb -> blocked_on = NULL;
+    tcb -> waiting_in = NULL;
+    tcb -> fpu_state = NULL;
+    thr_register(tcb);
 
     // Allocate kernel stack for this thread, 1 page as default
     tcb -> stack_size = 4096;
@@ -86,8 +143,8 @@ TCB *thr_create(unsigned int eip, int run)
     {
         // if not run, we put it in the run queue and set
         // the state to be THREAD_INIT
-        list_insert_last(&runnable_queue, &tcb -> thread_list_node);
         tcb -> state = THREAD_INIT;
+        runq_insert(tcb);
     }
     return tcb;
 }
\ No newline at end of file
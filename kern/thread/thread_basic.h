@@ -18,4 +18,10 @@ void thr_init();
 
 TCB *thr_create(unsigned int eip, int run);
 
+void thr_register(TCB *tcb);
+
+void thr_unregister(TCB *tcb);
+
+TCB *thr_lookup(int tid);
+
 #endif /* _THREAD_H */
@@ -0,0 +1,77 @@
+/** @file atomic.h
+ *
+ *  @brief Atomic operations on 32 bit words, shared by the kernel and
+ *         user space, which each link their own copy of atomic.S
+ *
+ *  Every operation is a function call, so the compiler neither keeps
+ *  the word in a register across it nor moves other memory accesses
+ *  over it. On x86 loads are not reordered with other loads and stores
+ *  are not reordered with other stores, so atomic_load has acquire and
+ *  atomic_store has release semantics without a fence. Only a store
+ *  followed by a load of another word needs memory_barrier.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#ifndef _ATOMIC_H
+#define _ATOMIC_H
+
+#ifndef ASSEMBLER
+
+/** @brief Replace a word if it holds an expected value
+ *
+ *  @param addr the word
+ *  @param expected the value the word should hold
+ *  @param value the value to store
+ *  @return the old value, the store happened iff it equals expected
+ */
+int atomic_cas(volatile int *addr, int expected, int value);
+
+/** @brief Add to a word
+ *
+ *  @param addr the word
+ *  @param delta the amount to add, may be negative
+ *  @return the old value
+ */
+int atomic_add(volatile int *addr, int delta);
+
+/** @brief Store a value in a word
+ *
+ *  @param addr the word
+ *  @param value the value to store
+ *  @return the old value
+ */
+int atomic_swap(volatile int *addr, int value);
+
+/** @brief Read a word, later accesses are not done before it
+ *
+ *  @param addr the word
+ *  @return the value
+ */
+int atomic_load(volatile int *addr);
+
+/** @brief Write a word after all earlier accesses
+ *
+ *  @param addr the word
+ *  @param value the value to store
+ *  @return void
+ */
+void atomic_store(volatile int *addr, int value);
+
+/** @brief Full fence, no access is moved over it in either direction
+ *
+ *  @return void
+ */
+void memory_barrier(void);
+
+/** @brief Tell the processor we are in a spin wait loop
+ *
+ *  @return void
+ */
+void cpu_relax(void);
+
+#endif /* ASSEMBLER */
+
+#endif /* _ATOMIC_H */
@@ -0,0 +1,40 @@
+/** @file syscall_ext.h
+ *
+ *  @brief System calls we add on top of the Pebbles spec, using the
+ *         reserved syscall numbers from syscall_int.h
+ *
+ *  Shared by the kernel, which installs the handlers, and user space,
+ *  which has a stub for each of them in libsyscall.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#ifndef _SYSCALL_EXT_H
+#define _SYSCALL_EXT_H
+
+#include <syscall_int.h>
+
+#define SET_PRIORITY_INT    SYSCALL_RESERVED_0
+#define GET_IDLE_TICKS_INT  SYSCALL_RESERVED_1
+#define FUTEX_WAIT_INT      SYSCALL_RESERVED_2
+#define FUTEX_WAKE_INT      SYSCALL_RESERVED_3
+#define GET_ZERO_POOL_STATS_INT SYSCALL_RESERVED_4
+
+/* Scheduling priorities, a smaller number runs first */
+#define PRIORITY_HIGHEST    0
+#define PRIORITY_DEFAULT    15
+#define PRIORITY_LOWEST     30
+
+#ifndef ASSEMBLER
+
+int set_priority(int tid, int priority);
+unsigned int get_idle_ticks(void);
+int futex_wait(int *addr, int expected);
+int futex_wake(int *addr, int count);
+int get_zero_pool_stats(unsigned int *hits, unsigned int *misses);
+
+#endif /* ASSEMBLER */
+
+#endif /* _SYSCALL_EXT_H */
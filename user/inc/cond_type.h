@@ -9,17 +9,23 @@
 #ifndef _COND_TYPE_H
 #define _COND_TYPE_H
 
-#include "linked_list.h"
 #include "spinlock_type.h"
 #include "mutex_type.h"
 
 #define CVAR_UNAVAILABLE -1
 #define CVAR_AVAILABLE 0
 
+// A thread waiting on the cond_var, lives on the waiting thread's stack
+typedef struct cond_waiter {
+	volatile int signaled;		// Set when the waiter is woken up
+	struct cond_waiter *next;	// The next waiter in FIFO order
+} cond_waiter_t;
+
 typedef struct cond {
 	int status; 			// The status of this condition variable
 	spinlock_t lock;	// A spinlock to avoid race conditions when add/remove the waitlist
-	list wait_list;		// The list that store waiting threads
+	cond_waiter_t *head;	// The waiter that is woken up first
+	cond_waiter_t *tail;	// The waiter that came last
 } cond_t;
 
 int cond_init(cond_t *cv);
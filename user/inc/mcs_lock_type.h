@@ -0,0 +1,34 @@
+ /**
+ * @file mcs_lock_type.h
+ *
+ * @brief The MCS queue lock. Each thread that wants the lock brings a
+ *        node, usually on its own stack, and appends it to the queue
+ *        with one swap of the tail pointer. A waiter only spins on its
+ *        own node, and the holder passes the lock on by clearing the
+ *        flag in its successor's node, so threads get in in the order
+ *        they arrived and waiters do not fight over a shared word.
+ *
+ *        The node must stay alive from mcs_lock_lock to mcs_lock_unlock.
+ *
+ * @author Xianqi Zeng (xianqiz)
+ * @author Tianyuan Ding (tding)
+ *
+ */
+
+#ifndef _MCS_LOCK_TYPE_H
+#define _MCS_LOCK_TYPE_H
+
+typedef struct mcs_node {
+    struct mcs_node * volatile next;    // The thread that waits after us
+    volatile int waiting;               // Cleared when we get the lock
+} mcs_node_t;
+
+typedef struct mcs_lock {
+    mcs_node_t * volatile tail;         // The last node, NULL if unlocked
+} mcs_lock_t;
+
+void mcs_lock_init(mcs_lock_t *ml);
+void mcs_lock_lock(mcs_lock_t *ml, mcs_node_t *me);
+void mcs_lock_unlock(mcs_lock_t *ml, mcs_node_t *me);
+
+#endif /* _MCS_LOCK_TYPE_H */
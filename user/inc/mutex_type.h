@@ -17,9 +17,22 @@
 #define MUTEX_UNLOCKED 0
 #define MUTEX_UNAVAILABLE -1
 
+// A thread waiting for the mutex, lives on the waiting thread's stack
+typedef struct mutex_waiter {
+    int tid;                        // The waiting thread
+    volatile int granted;           // Set when the mutex is handed over
+    struct mutex_waiter *next;      // The next waiter in FIFO order
+} mutex_waiter_t;
+
 typedef struct mutex {
     int status;			// The status for the mutex
-    spinlock_t lock;	// The core functioning spinlock
+    spinlock_t lock;	// Held while the mutex is held, stays held when
+    					// the mutex is handed to a waiter
+    volatile int owner;	// The tid of the holder, -1 if none or if it
+    					// took the mutex on the fast path
+    spinlock_t guard;	// Protects the waiter list
+    mutex_waiter_t *head;	// The first waiter, who gets the mutex next
+    mutex_waiter_t *tail;	// The last waiter
 } mutex_t;
 
 int mutex_init(mutex_t *mp);
@@ -1,47 +1,24 @@
  /**
  * @file rwlock_type.h
  *
- * @brief We implement rw lock based on the binary semaphores. 
- *        Each semaphore has its own purpose. We used five semaphores in total
- *        for different types of purposes. The benefits for using binary
- *        semaphore are:
- *        1. It's clear to assign different responsibilities for different
- *           semaphores. Each of them will have its own purpose.
- *        2. The implementation will only depend on semaphores, instead of 
- *           a bunch of different syncronization services. This means that
- *           if any other syncronization services fail, as long as semaphore
- *           works, the reader writer lock will still work fine.
+ * @brief The reader writer lock keeps everything it needs to decide who
+ *        may enter in a single state word, so taking or releasing it
+ *        without conflict is one atomic update:
+ *        A. The low 16 bits count the readers inside.
+ *        B. RW_WRITER is set while a writer is inside.
+ *        C. The bits above count the writers waiting. Readers do not
+ *           enter while a writer waits, which gives writers preference.
+ *        D. RW_READERS_WAITING is set by a reader before it sleeps, so
+ *           releasing the lock only makes a system call when somebody
+ *           sleeps.
  *
- *        On top of the semaphores, we used two integers for recording total
- *        number of readers and writers. The interaction between semaphores and 
- *        the two counts are as following:
- *        A. When initilized, count will be set to 0 and all semaphores will be
- *           to 1 as unlocked state.
- *        B. If lock function is called, we need the check whether it's by 
- *           reader or by writer, and then we will use the general semaphore for 
- *           the lock action. We will use the reader semaphore to lock that only
- *           one thread could have the authorization to act on reader side. We 
- *           will finally use the reader count semaphore to lock the actions for
- *           the read count changes. When the first reader, we will lock writers
- *           from accessing.
- *           It it's writer's action, then we don't have the two first locks,
- *           since we wnat to give wrtier higher priority in the action queue.
- *           AKA, we are implementing the writer prefer method.
- *        C. If unlock function is called, we just need to lock count 
- *           semaphores, and change the corresponding count number, then unlock
- *           writer or reader depending on whether the actor is the last writer 
- *           or the last reader already
- *        D. For downgrade, we just decrease writer count and increase reader
- *           count, and finally unlock readers since the writer that was just
- *           now writing must be the only writer and all other readers, after
- *           the downgrade happens, will be granted the authorization to read
- *           unless a writer is queuing, which will have higher priority by 
- *           locking reader lock in line 93 in the source file of the 
- *           implementation.
- *         
+ *        Readers sleep on the state word itself with futex_wait and are
+ *        all woken when the last writer leaves. Writers sleep on a
+ *        separate sequence word, which is bumped whenever a writer may
+ *        be able to go in, so one writer is woken at a time.
  *
- *
- *        
+ *        Downgrading turns the writer into a reader with one update and
+ *        lets the sleeping readers in, unless a writer is waiting.
  *
  * @author Jonathan Xianqi Zeng (xianqiz)
  * @author Tianyuan Ding (tding)
@@ -51,24 +28,18 @@
 #ifndef _RWLOCK_TYPE_H
 #define _RWLOCK_TYPE_H
 
-#include <sem_type.h>
-
-#define NULL_CNT -1
+#define RW_READER               0x00000001
+#define RW_READERS_MASK         0x0000ffff
+#define RW_WRITER               0x00010000
+#define RW_WRITER_WAITING       0x00020000
+#define RW_WRITERS_WAITING_MASK 0x3ffe0000
+#define RW_READERS_WAITING      0x40000000
 
 struct rwlock {
-    int         readcnt;  //init 0
-    int         writecnt; //init 0
-    //protects readcnt
-    sem_t       rcnt_mutex; //init 1
-    //protects writecnt
-    sem_t       wcnt_mutex; //init 1
-    sem_t       gen_mutex; //init 1
-    //protects write
-    sem_t       w;       //init 1
-    //protects read
-    sem_t       r;       //init 1
+    volatile int state;         // Readers, writer and waiters, see above
+    volatile int writer_seq;    // Bumped to wake up a waiting writer
 };
 
 typedef struct rwlock rwlock_t;
 
-#endif /* _RWLOCK_TYPE_H */
\ No newline at end of file
+#endif /* _RWLOCK_TYPE_H */
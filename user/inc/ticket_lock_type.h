@@ -0,0 +1,26 @@
+ /**
+ * @file ticket_lock_type.h
+ *
+ * @brief A fair spinlock. Every thread that wants the lock takes the
+ *        next ticket with one fetch-and-add, and the lock is held by
+ *        the thread whose ticket is being served, so threads get in in
+ *        the order they arrived.
+ *
+ * @author Xianqi Zeng (xianqiz)
+ * @author Tianyuan Ding (tding)
+ *
+ */
+
+#ifndef _TICKET_LOCK_TYPE_H
+#define _TICKET_LOCK_TYPE_H
+
+typedef struct ticket_lock {
+    volatile int next;      // The ticket the next thread takes
+    volatile int serving;   // The ticket of the thread holding the lock
+} ticket_lock_t;
+
+void ticket_lock_init(ticket_lock_t *tl);
+void ticket_lock_lock(ticket_lock_t *tl);
+void ticket_lock_unlock(ticket_lock_t *tl);
+
+#endif /* _TICKET_LOCK_TYPE_H */
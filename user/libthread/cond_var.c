@@ -3,21 +3,25 @@
 *
 * @brief The cond_var is implemented with a waitlist and a 
 *        spinlock to protect the list
-*        If the thread wants to wait, it will put itself into the waitlist
-*        If the thread wants to wake up the thread, it will dequeue a thread
-*        from the list and continuing wakening that thread until success
+*        If the thread wants to wait, it will put a waiter record from
+*        its own stack into the waitlist and sleep on the record with
+*        futex_wait until it is marked signaled.
+*        If the thread wants to wake up the thread, it will dequeue a
+*        waiter, mark it and wake it with futex_wake. A waiter that has
+*        not gone to sleep yet sees the mark and does not sleep at all,
+*        so no retries are needed and nothing is ever allocated.
 * @author Xianqi Zeng (xianqiz)
 * @author Tianyuan Ding (tding)
 * @bugs No known bugs
 */
 
 #include <syscall.h>
+#include <syscall_ext.h>
 #include "cond_type.h"
 #include "spinlock_type.h"
-#include "linked_list.h"
 #include "mutex.h"
 #include "assert.h"
-#include "malloc.h"
+#include <stddef.h>
 
 /** @brief The function to initialize the cond_var
  *
@@ -29,7 +33,7 @@ int cond_init(cond_t *cv)
     assert(cv != NULL);
     cv -> status = CVAR_AVAILABLE;
     spinlock_init(&(cv -> lock));
-    list_init(&(cv -> wait_list));
+    cv -> head = cv -> tail = NULL;
     return 0;
 }
 
@@ -43,7 +47,7 @@ void cond_destroy(cond_t *cv)
 {
     // Vanish when trying to destroy cond_var while threads are
     // blocked waiting on it.
-    if (cv -> wait_list.length != 0) vanish();
+    if (cv -> head != NULL) vanish();
     spinlock_destroy(&cv -> lock); // Destroy a spinlock
     cv -> status = CVAR_UNAVAILABLE;
 }
@@ -59,20 +63,43 @@ void cond_wait(cond_t *cv, mutex_t *mp)
 {
     if (cv == NULL || cv -> status == CVAR_UNAVAILABLE ||
         mp -> status == MUTEX_UNAVAILABLE) return;
-    int tid = gettid();
 
+    cond_waiter_t self;
+    self.signaled = 0;
+    self.next = NULL;
+
+    // Queue up before letting go of the mutex, so a signal sent after
+    // the caller checked its condition finds us
     spinlock_lock(&cv -> lock);
+    if (cv -> tail == NULL)
+        cv -> head = &self;
+    else
+        cv -> tail -> next = &self;
+    cv -> tail = &self;
+    spinlock_unlock(&cv -> lock);
     mutex_unlock(mp);
 
-    // Insert that thread into waitlist
-    list_insert_last(&cv -> wait_list, make_node(NULL, tid));
-
-    int reject = 0;
-    spinlock_unlock(&cv -> lock);
-    deschedule(&reject);  // Deschedule and unlock
+    // A wake up meant for an earlier record at this address may come
+    // late, so only the mark counts
+    while (!self.signaled)
+        futex_wait((int *)&self.signaled, 0);
     mutex_lock(mp);       // Grab the lock again
 }
 
+/** @brief Mark a dequeued waiter signaled and wake it up
+ *
+ *  The waiter may return and reuse its stack as soon as it sees the
+ *  mark, so the record is not read after that.
+ *
+ *  @param waiter The waiter, no longer in the waitlist
+ *  @return void
+ */
+static void cond_wake(cond_waiter_t *waiter)
+{
+    waiter -> signaled = 1;
+    futex_wake((int *)&waiter -> signaled, 1);
+}
+
 /** @brief The function to wake up a thread waiting on cv
  *
  *  @param cv The cond_var
@@ -80,21 +107,20 @@ void cond_wait(cond_t *cv, mutex_t *mp)
  */
 void cond_signal(cond_t *cv)
 {
-
     if (cv == NULL || cv -> status == CVAR_UNAVAILABLE) return;
-    node *curr_node;
-    spinlock_lock(&cv -> lock);
 
-    curr_node = list_delete_first(&cv -> wait_list);
-    if (curr_node != NULL) {
-        while (1) {
-            if (make_runnable(curr_node -> tid) == 0) break;
-            else yield(-1); // If make runnable fails, we let other threads run
-                            // until we successfully run the target thread
-        }
+    spinlock_lock(&cv -> lock);
+    cond_waiter_t *waiter = cv -> head;
+    if (waiter != NULL)
+    {
+        cv -> head = waiter -> next;
+        if (cv -> head == NULL)
+            cv -> tail = NULL;
     }
-
     spinlock_unlock(&cv -> lock);
+
+    if (waiter != NULL)
+        cond_wake(waiter);
 }
 
 /** @brief Wakes up all the sleeping threads in the list
@@ -105,17 +131,17 @@ void cond_signal(cond_t *cv)
 void cond_broadcast(cond_t *cv)
 {
     if (cv == NULL || cv -> status == CVAR_UNAVAILABLE) return;
-    node *curr_node;
+
+    // Take the whole list at once, later waiters wait for the next one
     spinlock_lock(&cv -> lock);
-    while (cv -> wait_list.length != 0) {
-        curr_node = list_delete_first(&cv -> wait_list);
-          if (curr_node != NULL) {
-              while (1) {
-              if (make_runnable(curr_node -> tid) == 0) break;
-              else yield(-1); // If make runnable fails, we let other threads run
-                              // until we successfully run the target thread
-          }
-        }
-    }
+    cond_waiter_t *waiter = cv -> head;
+    cv -> head = cv -> tail = NULL;
     spinlock_unlock(&cv -> lock);
+
+    while (waiter != NULL)
+    {
+        cond_waiter_t *next = waiter -> next;
+        cond_wake(waiter);
+        waiter = next;
+    }
 }
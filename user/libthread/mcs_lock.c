@@ -0,0 +1,90 @@
+/**
+* @file mcs_lock.c
+*
+* @brief The MCS lock from mcs_lock_type.h. Pointers are swapped and
+*        compared as 32 bit words. Since only one thread runs at a time,
+*        a waiter whose predecessor is not running yields after a while.
+*
+* @author Xianqi Zeng (xianqiz)
+* @author Tianyuan Ding (tding)
+*
+*/
+#include <syscall.h>
+#include <stddef.h>
+#include <atomic.h>
+#include "mcs_lock_type.h"
+
+// Looks at our node before a waiter yields
+#define SPIN_YIELD_TRIES 64
+
+/** @brief Spin with backoff until a word is no longer zero or no
+ *         longer nonzero
+ *
+ *  @param word The word to watch
+ *  @param until_set 1 to wait for a nonzero value, 0 for zero
+ *  @return void
+ */
+static void mcs_spin(volatile int *word, int until_set)
+{
+    int tries = 0;
+    while ((atomic_load(word) != 0) != until_set)
+    {
+        if (++tries == SPIN_YIELD_TRIES)
+        {
+            yield(-1);
+            tries = 0;
+        }
+        else
+            cpu_relax();
+    }
+}
+
+/** @brief Initialize an MCS lock, which is unlocked initially
+ *
+ *  @param ml A pointer to the lock
+ *  @return void
+ */
+void mcs_lock_init(mcs_lock_t *ml)
+{
+    ml -> tail = NULL;
+}
+
+/** @brief Queue up behind the current tail and wait for our turn
+ *
+ *  @param ml A pointer to the lock
+ *  @param me The caller's node
+ *  @return void
+ */
+void mcs_lock_lock(mcs_lock_t *ml, mcs_node_t *me)
+{
+    me -> next = NULL;
+    me -> waiting = 1;
+
+    mcs_node_t *prev =
+        (mcs_node_t *)atomic_swap((volatile int *)&ml -> tail, (int)me);
+    if (prev == NULL) return;
+
+    atomic_store((volatile int *)&prev -> next, (int)me);
+    mcs_spin(&me -> waiting, 0);
+}
+
+/** @brief Pass the lock to the next node, or leave it unlocked
+ *
+ *  If there is no next node yet but the tail has moved, a thread is
+ *  between swapping the tail and linking itself in, so we wait for the
+ *  link.
+ *
+ *  @param ml A pointer to the lock
+ *  @param me The node the caller locked with
+ *  @return void
+ */
+void mcs_lock_unlock(mcs_lock_t *ml, mcs_node_t *me)
+{
+    if (me -> next == NULL)
+    {
+        if (atomic_cas((volatile int *)&ml -> tail, (int)me, 0) == (int)me)
+            return;
+        mcs_spin((volatile int *)&me -> next, 1);
+    }
+    atomic_store(&me -> next -> waiting, 0);
+}
@@ -1,20 +1,37 @@
 /**
 * @file mutex.c
 *
-* @brief  The mutex is implemented by a spinlock. Note that we didn't ensure 
-*         bounded waiting because otherwise we have to add more complexity
-*         to the code. We expect that our mutex should be as simple as 
-*         possible. Cond_var, semaphore and rwlocks are all depend on mutex.
-*         Therefore a spinlock is simple enough to suffice.
+* @brief  The mutex spins for a short while, then queues up and sleeps.
+*         A thread that finds the mutex held first retries a few times,
+*         in case the holder is about to let go. Then it puts a waiter
+*         record from its own stack at the tail of the mutex's waiter
+*         list, yields to the holder so that it can finish its critical
+*         section, and sleeps on the record with futex_wait if it still
+*         has not got the mutex. Sleeping on its own word instead of
+*         using deschedule means a late wake up can only reach another
+*         futex waiter, and those always check their word again.
+*
+*         Unlocking with waiters hands the mutex directly to the first
+*         one: the lock word stays held and the waiter is told it owns
+*         the mutex now, so a thread that comes later cannot grab it
+*         first, and waiters are served in FIFO order.
+*
+*         Cond_var, semaphore and rwlocks are all depend on mutex.
 *
 * @author Xianqi Zeng (xianqiz)
 * @author Tianyuan Ding (tding)
 * @bugs No known bugs
 */
 #include <syscall.h>
+#include <syscall_ext.h>
 #include "mutex_type.h"
 #include "malloc.h"
 #include "spinlock_type.h"
+#include "atomic_xchange.h"
+#include <atomic.h>
+
+// Tries before a thread queues up, the holder may be about to unlock
+#define MUTEX_SPIN_TRIES 32
 
 /** @brief The function to initialize a mutex, which is unlocked initially
  *
@@ -25,6 +42,9 @@ int mutex_init(mutex_t *mp)
 {
     mp -> status = MUTEX_UNLOCKED;
     spinlock_init(&(mp -> lock));
+    spinlock_init(&(mp -> guard));
+    mp -> owner = -1;
+    mp -> head = mp -> tail = NULL;
     return 0;
 }
 
@@ -35,34 +55,117 @@ int mutex_init(mutex_t *mp)
  */
 void mutex_destroy(mutex_t *mp)
 {
-    spinlock_destroy(&mp -> lock); // Destroy a spinlock
-
     // Vanish when trying to destroy a locking mutex
-    if (mp -> status == MUTEX_LOCKED) vanish();  
+    if (mp -> status == MUTEX_LOCKED || mp -> head != NULL) vanish();
+    spinlock_destroy(&mp -> lock); // Destroy a spinlock
+    spinlock_destroy(&mp -> guard);
     mp -> status = MUTEX_UNAVAILABLE;
 }
 
+/** @brief Try to take the lock word once
+ *
+ *  Reads it before exchanging, so a busy mutex is not written to.
+ *
+ *  @param mp A pointer to the mutex
+ *  @return 1 if we got the mutex, 0 otherwise
+ */
+static int mutex_try(mutex_t *mp)
+{
+    if (*(volatile int *)&mp -> lock.state == SPINLOCK_LOCKED) return 0;
+    return atomic_xchange(&mp -> lock.state) == SPINLOCK_UNLOCKED;
+}
+
 /** @brief The function to lock a mutex
  *
- *  @param a pointer to the list to be initialized
+ *  @param mp A pointer to the mutex
  *  @return nothing
  */
 void mutex_lock(mutex_t *mp)
 {
+    int i;
+    mutex_waiter_t self;
+
     if (mp -> status == MUTEX_UNAVAILABLE) return;
-    spinlock_lock(&mp -> lock);
+
+    for (i = 0; i < MUTEX_SPIN_TRIES; ++i)
+    {
+        if (mutex_try(mp))
+        {
+            // gettid is a system call, too slow for the fast path
+            mp -> owner = -1;
+            mp -> status = MUTEX_LOCKED;
+            return;
+        }
+        cpu_relax();
+    }
+
+    self.tid = gettid();
+    self.granted = 0;
+    self.next = NULL;
+
+    spinlock_lock(&mp -> guard);
+    // The holder may have unlocked since, and unlocking checks the
+    // waiter list under the guard, so this try cannot miss a handoff
+    if (mutex_try(mp))
+    {
+        spinlock_unlock(&mp -> guard);
+        mp -> owner = self.tid;
+        mp -> status = MUTEX_LOCKED;
+        return;
+    }
+    if (mp -> tail == NULL)
+        mp -> head = &self;
+    else
+        mp -> tail -> next = &self;
+    mp -> tail = &self;
+    int owner = mp -> owner;
+    spinlock_unlock(&mp -> guard);
+
+    // Let the holder run its critical section, then sleep until we are
+    // handed the mutex. The owner is only known if it got the mutex on
+    // the slow path or by handoff, and may be stale, yield only needs a
+    // hint.
+    if (!self.granted)
+        yield(owner > 0 ? owner : -1);
+    while (!self.granted)
+        futex_wait((int *)&self.granted, 0);
+
+    // The unlocking thread already made us the owner
     mp -> status = MUTEX_LOCKED;
 }
 
-/** @brief The function to initialize the doubly linked list
+/** @brief The function to unlock a mutex, handing it to the first
+ *         waiter if there is one
  *
- *  @param a pointer to the list to be initialized
+ *  @param mp A pointer to the mutex
  *  @return nothing
  */
 void mutex_unlock(mutex_t *mp)
 {
     if (mp -> status == MUTEX_UNAVAILABLE) return;
-    mp -> status = MUTEX_UNLOCKED;
-    spinlock_unlock(&mp -> lock);
-}
 
+    spinlock_lock(&mp -> guard);
+    mutex_waiter_t *next = mp -> head;
+    if (next == NULL)
+    {
+        mp -> owner = -1;
+        mp -> status = MUTEX_UNLOCKED;
+        spinlock_unlock(&mp -> lock);
+        spinlock_unlock(&mp -> guard);
+        return;
+    }
+
+    mp -> head = next -> next;
+    if (mp -> head == NULL)
+        mp -> tail = NULL;
+    // The waiter returns as soon as it sees granted, so its record must
+    // not be touched after that
+    mp -> owner = next -> tid;
+    next -> granted = 1;
+    spinlock_unlock(&mp -> guard);
+
+    // Finds nobody if the waiter has not gone to sleep yet, it then sees
+    // granted. If the record is gone, a waiter that later uses the same
+    // stack word just checks it again and goes back to sleep.
+    futex_wake((int *)&next -> granted, 1);
+}
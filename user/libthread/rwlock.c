@@ -9,18 +9,17 @@
 *
 */
 #include <syscall.h>
+#include <syscall_ext.h>
 #include <thread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
+#include <limits.h>
 #include <rwlock.h>
+#include <atomic.h>
 
 /** @brief The initialization function of reader writer lock
- *
- *  Initilize the reader writer lock. The reader writer lock structure
- *  has five semaphores in it. It works as the documentation in the
- *  README file states;
  *
  *  @param pointer to the lock structure
  *  @return 0 on success;
@@ -28,110 +27,158 @@
 int rwlock_init(rwlock_t *rwlock)
 {
     assert(rwlock != NULL);
-    rwlock->readcnt = 0;
-    rwlock->writecnt = 0;
-    sem_init(&rwlock->rcnt_mutex, 1);
-    sem_init(&rwlock->wcnt_mutex, 1);
-    sem_init(&rwlock->gen_mutex, 1);
-    sem_init(&rwlock->w, 1);
-    sem_init(&rwlock->r, 1);
+    rwlock->state = 0;
+    rwlock->writer_seq = 0;
     return 0;
 }
 
-/** @brief The function to destroy the lock
- *
- *  destroy every element in the structure, and set the counters;
+/** @brief The function to destroy the lock, vanish if it is in use
  *
  *  @param pointer to the lock structure
  *  @return nothing
  */
 void rwlock_destroy(rwlock_t *rwlock )
 {
-    rwlock->readcnt = NULL_CNT;
-    rwlock->writecnt = NULL_CNT;
-    sem_destroy(&rwlock->rcnt_mutex);
-    sem_destroy(&rwlock->wcnt_mutex);
-    sem_destroy(&rwlock->gen_mutex);
-    sem_destroy(&rwlock->w);
-    sem_destroy(&rwlock->r);
+    if (rwlock->state != 0) vanish();
 }
 
-/** @brief The function to lock the rwlock
+/** @brief Let a waiting writer try to go in
  *
- *  Lock the reader writer lock; two cases:
- *  1. if it's a reader section, then increase the reader count,
- *     and if this is the first reader that comes into the buffer,
- *     we lock the writer lock until the the last reader comes out
- *     in the unlock function;
- *  2. if it's the writer section, we increase the writer count.
- *     Since we only allow one writer, we don't check count.
- *     And then we lock both reader and writer.
+ *  @param pointer to the lock structure
+ *  @return nothing
+ */
+static void rwlock_wake_writer(rwlock_t *rwlock)
+{
+    atomic_add(&rwlock->writer_seq, 1);
+    futex_wake((int *)&rwlock->writer_seq, 1);
+}
+
+/** @brief Wake up all sleeping readers, if there are any
  *
- *  @param pointer to the lock structure,
- *  @return 0 on success;
+ *  @param pointer to the lock structure
+ *  @return nothing
  */
-void rwlock_lock(rwlock_t *rwlock, int type )
+static void rwlock_wake_readers(rwlock_t *rwlock)
 {
-    //reader section
-    if (type == RWLOCK_READ)
+    int s;
+    do {
+        s = rwlock->state;
+        if (!(s & RW_READERS_WAITING)) return;
+    } while (atomic_cas(&rwlock->state, s,
+                        s & ~RW_READERS_WAITING) != s);
+    futex_wake((int *)&rwlock->state, INT_MAX);
+}
+
+/** @brief Take the lock as a reader
+ *
+ *  A reader goes in as long as no writer is inside or waiting,
+ *  otherwise it marks that readers are waiting and sleeps until the
+ *  state word changes.
+ *
+ *  @param pointer to the lock structure
+ *  @return nothing
+ */
+static void rwlock_lock_read(rwlock_t *rwlock)
+{
+    int s;
+    while (1)
     {
-        sem_wait(&rwlock->gen_mutex);
-        sem_wait(&rwlock->r);
-        sem_wait(&rwlock->rcnt_mutex);
-        rwlock->readcnt++;
-        if (rwlock->readcnt == 1)
-            sem_wait(&rwlock->w);
-        sem_signal(&rwlock->rcnt_mutex);
-        sem_signal(&rwlock->r);
-        sem_signal(&rwlock->gen_mutex);
+        s = rwlock->state;
+        if (!(s & (RW_WRITER | RW_WRITERS_WAITING_MASK)))
+        {
+            if (atomic_cas(&rwlock->state, s, s + RW_READER) == s)
+                return;
+            continue;
+        }
+        if (!(s & RW_READERS_WAITING))
+        {
+            if (atomic_cas(&rwlock->state, s,
+                           s | RW_READERS_WAITING) != s)
+                continue;
+            s |= RW_READERS_WAITING;
+        }
+        futex_wait((int *)&rwlock->state, s);
     }
-    //writer section
-    else
+}
+
+/** @brief Take the lock as a writer
+ *
+ *  A writer goes in if nobody is inside. Otherwise it counts itself as
+ *  waiting, which keeps new readers out, and sleeps until a releasing
+ *  thread bumps the sequence word. The sequence is read before the
+ *  state, so a bump in between makes futex_wait return right away.
+ *
+ *  @param pointer to the lock structure
+ *  @return nothing
+ */
+static void rwlock_lock_write(rwlock_t *rwlock)
+{
+    int s, seq;
+
+    if (atomic_cas(&rwlock->state, 0, RW_WRITER) == 0)
+        return;
+
+    atomic_add(&rwlock->state, RW_WRITER_WAITING);
+    while (1)
     {
-        sem_wait(&rwlock->wcnt_mutex);
-        rwlock->writecnt++;
-        sem_wait(&rwlock->r);
-        sem_wait(&rwlock->w);
-        sem_signal(&rwlock->wcnt_mutex);
+        seq = rwlock->writer_seq;
+        s = rwlock->state;
+        if (!(s & (RW_WRITER | RW_READERS_MASK)))
+        {
+            if (atomic_cas(&rwlock->state, s,
+                           s - RW_WRITER_WAITING + RW_WRITER) == s)
+                return;
+            continue;
+        }
+        futex_wait((int *)&rwlock->writer_seq, seq);
     }
 }
 
+/** @brief The function to lock the rwlock
+ *
+ *  @param pointer to the lock structure,
+ *  @param type RWLOCK_READ or RWLOCK_WRITE
+ *  @return nothing
+ */
+void rwlock_lock(rwlock_t *rwlock, int type )
+{
+    if (type == RWLOCK_READ)
+        rwlock_lock_read(rwlock);
+    else
+        rwlock_lock_write(rwlock);
+}
+
 /** @brief The function to unlock the rwlock
  *
- *  Unlock the reader writer lock; two cases:
- *  1. If it's a reader section, then decrease the reader count,
- *     and if it's already the last reader in the buffer, we tell
- *     writer that it can proceed
- *  2. if it's the writer section, we increase the writer count.
- *     Since we only allow one writer, we don't check count.
- *     And then we lock both reader and writer.
+ *  Only the holder may unlock, so the writer bit tells whether the
+ *  caller is the writer or one of the readers.
+ *  1. The last reader out lets a waiting writer in.
+ *  2. A writer lets the next waiting writer in, or else all the
+ *     sleeping readers.
  *
  *  @param pointer to the lock structure,
- *  @return 0 on success;
+ *  @return nothing
  */
 void rwlock_unlock( rwlock_t *rwlock )
 {
+    int old;
+
     //unlock a reader
-    if (rwlock->readcnt > 0)
+    if (!(rwlock->state & RW_WRITER))
     {
-        sem_wait(&rwlock->rcnt_mutex);
-        rwlock->readcnt--;
-        //tell writer you can proceed
-        if (rwlock->readcnt == 0)
-            sem_signal(&rwlock->w);
-        sem_signal(&rwlock->rcnt_mutex);
+        old = atomic_add(&rwlock->state, -RW_READER);
+        if ((old & RW_READERS_MASK) == RW_READER &&
+            (old & RW_WRITERS_WAITING_MASK))
+            rwlock_wake_writer(rwlock);
+        return;
     }
+
     //unlock a writer
+    old = atomic_add(&rwlock->state, -RW_WRITER);
+    if (old & RW_WRITERS_WAITING_MASK)
+        rwlock_wake_writer(rwlock);
     else
-    {
-        sem_wait(&rwlock->wcnt_mutex);
-        rwlock->writecnt--;
-        //tell reader you can proceed
-        if (rwlock->writecnt == 0)
-            sem_signal(&rwlock->r);
-        sem_signal(&rwlock->wcnt_mutex);
-    }
-
+        rwlock_wake_readers(rwlock);
 }
 
 /** @brief Downgrade the lock in write mode when it's no longer
@@ -142,11 +189,7 @@ void rwlock_unlock( rwlock_t *rwlock )
  */
 void rwlock_downgrade( rwlock_t *rwlock )
 {
-    sem_wait(&rwlock->wcnt_mutex);
-    sem_wait(&rwlock->rcnt_mutex);
-    rwlock->writecnt--;
-    rwlock->readcnt++;
-    sem_signal(&rwlock->rcnt_mutex);
-    sem_signal(&rwlock->wcnt_mutex);
-    sem_signal(&rwlock->r);
-}
\ No newline at end of file
+    int old = atomic_add(&rwlock->state, RW_READER - RW_WRITER);
+    if (!(old & RW_WRITERS_WAITING_MASK))
+        rwlock_wake_readers(rwlock);
+}
@@ -2,7 +2,9 @@
 * @file spinlock.c
 *
 * @brief This file provides several functions to manipulate spinlock defined in spinlock.h
-*        A spinlock just spins until it grabs a lock.
+*        A spinlock just spins until it grabs a lock. Since only one
+*        thread runs at a time, a holder that got preempted cannot let go
+*        while we spin, so we give up the CPU after a few tries.
 *
 * @author Xianqi Zeng (xianqiz)
 * @author Tianyuan Ding (tding)
@@ -12,6 +14,10 @@
 #include "spinlock_type.h"
 #include "assert.h"
 #include "atomic_xchange.h"
+#include <atomic.h>
+
+// Failed tries before a waiter yields
+#define SPIN_YIELD_TRIES 64
 
 /** @brief Initialize a spinlock
  *
@@ -25,15 +31,25 @@ void spinlock_init(spinlock_t *sl)
 
 /** @brief Attempts to grab a lock
  *
- *         Using atomic_xchange until it grabs a lock
+ *         Using atomic_xchange until it grabs a lock, pausing between
+ *         tries and yielding every SPIN_YIELD_TRIES of them
  *
  *  @param sl A pointer to the spinlock
  *  @return void
  */
 void spinlock_lock(spinlock_t *sl)
 {
-    int is_locked;
-    while ((is_locked = atomic_xchange(&(sl->state)))) continue;
+    int tries = 0;
+    while (atomic_xchange(&(sl->state)) == SPINLOCK_LOCKED)
+    {
+        if (++tries == SPIN_YIELD_TRIES)
+        {
+            yield(-1);
+            tries = 0;
+        }
+        else
+            cpu_relax();
+    }
 }
 
 /** @brief Unlock a spinlock
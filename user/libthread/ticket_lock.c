@@ -0,0 +1,71 @@
+/**
+* @file ticket_lock.c
+*
+* @brief The ticket lock from ticket_lock_type.h. A waiter backs off in
+*        proportion to the number of tickets ahead of it, so the serving
+*        word is not read over and over while the lock passes through
+*        other threads first. Since only one thread runs at a time, the
+*        thread whose turn it is may be waiting for the CPU, so a waiter
+*        yields after a while.
+*
+* @author Xianqi Zeng (xianqiz)
+* @author Tianyuan Ding (tding)
+*
+*/
+#include <syscall.h>
+#include <atomic.h>
+#include "ticket_lock_type.h"
+
+// Pauses per ticket ahead of us before we look again
+#define TICKET_BACKOFF 16
+
+// Looks at the serving word before a waiter yields
+#define SPIN_YIELD_TRIES 16
+
+/** @brief Initialize a ticket lock, which is unlocked initially
+ *
+ *  @param tl A pointer to the ticket lock
+ *  @return void
+ */
+void ticket_lock_init(ticket_lock_t *tl)
+{
+    tl -> next = 0;
+    tl -> serving = 0;
+}
+
+/** @brief Take a ticket and wait until it is served
+ *
+ *  @param tl A pointer to the ticket lock
+ *  @return void
+ */
+void ticket_lock_lock(ticket_lock_t *tl)
+{
+    int ticket = atomic_add(&tl -> next, 1);
+    int tries = 0;
+    int ahead, i;
+
+    while ((ahead = ticket - atomic_load(&tl -> serving)) != 0)
+    {
+        if (++tries == SPIN_YIELD_TRIES)
+        {
+            yield(-1);
+            tries = 0;
+            continue;
+        }
+        for (i = 0; i < ahead * TICKET_BACKOFF; ++i)
+            cpu_relax();
+    }
+}
+
+/** @brief Serve the next ticket
+ *
+ *  Only the holder writes the serving word, so no atomic update is
+ *  needed, just a store that comes after the critical section.
+ *
+ *  @param tl A pointer to the ticket lock
+ *  @return void
+ */
+void ticket_lock_unlock(ticket_lock_t *tl)
+{
+    atomic_store(&tl -> serving, tl -> serving + 1);
+}
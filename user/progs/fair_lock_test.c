@@ -0,0 +1,197 @@
+/** @file fair_lock_test.c
+ *
+ *  @brief Test for the ticket lock and the MCS lock
+ *
+ *  For each lock, a number of threads first take it over and over and
+ *  check that nobody else is inside the critical section with them and
+ *  that no increment of the shared counter was lost. Then the main
+ *  thread holds the lock while the threads queue up on it one after
+ *  another, and checks that they get in in the order they queued.
+ *
+ *  Usage: fair_lock_test [threads [rounds]]
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#include <syscall.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread.h>
+#include <ticket_lock_type.h>
+#include <mcs_lock_type.h>
+
+#define THREADS     8
+#define MAX_THREADS 32
+#define ROUNDS      500
+#define WORK        50
+#define STACK_SIZE  4096
+
+static ticket_lock_t ticket;
+static mcs_lock_t mcs;
+static int use_mcs;
+static int rounds = ROUNDS;
+
+static volatile int inside;         // threads in the critical section
+static volatile int overlaps;       // times a thread found company there
+static volatile int counter;
+
+static volatile int order[MAX_THREADS];
+static volatile int entered;
+
+/** @brief Take the lock under test
+ *
+ *  @param node the caller's node, only used by the MCS lock
+ *  @return void
+ */
+static void lock(mcs_node_t *node)
+{
+    if (use_mcs)
+        mcs_lock_lock(&mcs, node);
+    else
+        ticket_lock_lock(&ticket);
+}
+
+/** @brief Release the lock under test
+ *
+ *  @param node the node the caller locked with
+ *  @return void
+ */
+static void unlock(mcs_node_t *node)
+{
+    if (use_mcs)
+        mcs_lock_unlock(&mcs, node);
+    else
+        ticket_lock_unlock(&ticket);
+}
+
+/** @brief Take the lock rounds times and look for company inside
+ *
+ *  @param arg unused
+ *  @return NULL
+ */
+static void *contend(void *arg)
+{
+    mcs_node_t node;
+    int i, j;
+    for (i = 0; i < rounds; ++i)
+    {
+        lock(&node);
+        if (inside++ != 0)
+            overlaps++;
+        for (j = 0; j < WORK; ++j)
+            counter++;
+        inside--;
+        unlock(&node);
+    }
+    return NULL;
+}
+
+/** @brief Queue up once and record when we got in
+ *
+ *  @param arg the position this thread queued at
+ *  @return NULL
+ */
+static void *queue_up(void *arg)
+{
+    mcs_node_t node;
+    lock(&node);
+    order[entered++] = (int)arg;
+    unlock(&node);
+    return NULL;
+}
+
+/** @brief Check if one more thread has queued on the lock
+ *
+ *  @param last_next the next ticket before it came
+ *  @param last_tail the MCS tail before it came
+ *  @return 1 if it is queued, 0 otherwise
+ */
+static int queued(int last_next, mcs_node_t *last_tail)
+{
+    if (use_mcs)
+        return mcs.tail != last_tail;
+    return ticket.next != last_next;
+}
+
+/** @brief Run both checks on the lock selected by use_mcs
+ *
+ *  @param name the name of the lock, for the report
+ *  @param threads the number of threads to use
+ *  @return 0 if the lock passed, -1 otherwise
+ */
+static int check_lock(const char *name, int threads)
+{
+    int tids[MAX_THREADS];
+    mcs_node_t main_node;
+    mcs_node_t *tail = &main_node;
+    int next, i;
+
+    inside = overlaps = counter = 0;
+    for (i = 0; i < threads; ++i)
+    {
+        if ((tids[i] = thr_create(contend, NULL)) < 0)
+            return -1;
+    }
+    for (i = 0; i < threads; ++i)
+        thr_join(tids[i], NULL);
+    if (overlaps != 0 || counter != threads * rounds * WORK)
+    {
+        printf("fair_lock_test: %s: %d overlaps, counter %d of %d\n",
+               name, overlaps, counter, threads * rounds * WORK);
+        return -1;
+    }
+
+    // Let the threads queue one at a time behind us
+    entered = 0;
+    lock(&main_node);
+    next = ticket.next;
+    for (i = 0; i < threads; ++i)
+    {
+        if ((tids[i] = thr_create(queue_up, (void *)i)) < 0)
+            return -1;
+        while (!queued(next, tail))
+            yield(tids[i]);
+        next = ticket.next;
+        tail = mcs.tail;
+    }
+    unlock(&main_node);
+    for (i = 0; i < threads; ++i)
+        thr_join(tids[i], NULL);
+    for (i = 0; i < threads; ++i)
+    {
+        if (order[i] != i)
+        {
+            printf("fair_lock_test: %s: thread %d got in %dth\n",
+                   name, order[i], i + 1);
+            return -1;
+        }
+    }
+    printf("fair_lock_test: %s ok\n", name);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = THREADS;
+
+    if (argc > 1)
+        threads = atoi(argv[1]);
+    if (argc > 2)
+        rounds = atoi(argv[2]);
+    if (threads < 1 || threads > MAX_THREADS)
+        threads = THREADS;
+
+    thr_init(STACK_SIZE);
+    ticket_lock_init(&ticket);
+    mcs_lock_init(&mcs);
+
+    use_mcs = 0;
+    if (check_lock("ticket lock", threads) < 0)
+        exit(-1);
+    use_mcs = 1;
+    if (check_lock("mcs lock", threads) < 0)
+        exit(-1);
+    exit(0);
+}
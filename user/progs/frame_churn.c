@@ -0,0 +1,80 @@
+/** @file frame_churn.c
+ *
+ *  @brief Microbenchmark for the physical frame allocator
+ *
+ *  Repeatedly allocates a set of new_pages regions of different sizes,
+ *  touches every page, and removes them again in a scrambled order, so
+ *  that the free frames end up interleaved. The number of ticks spent
+ *  is reported at the end; with a constant time allocator it should
+ *  grow linearly with the number of rounds. It also reports how many
+ *  of the frames came from the pre-zeroed pool.
+ *
+ *  Usage: frame_churn [rounds]
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#include <syscall.h>
+#include <syscall_ext.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BASE_ADDR   ((char *)0x40000000)
+#define REGIONS     16
+#define MAX_PAGES   32
+#define ROUNDS      200
+
+/* region i lives at BASE_ADDR + i * MAX_PAGES pages */
+#define REGION_ADDR(i)  (BASE_ADDR + (i) * MAX_PAGES * PAGE_SIZE)
+
+int main(int argc, char *argv[])
+{
+    int rounds = ROUNDS;
+    int round, i, j;
+    int frames = 0;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+
+    unsigned int hits, misses;
+    get_zero_pool_stats(&hits, &misses);
+    unsigned int start = get_ticks();
+    for (round = 0; round < rounds; ++round)
+    {
+        for (i = 0; i < REGIONS; ++i)
+        {
+            int pages = 1 + (i * 7 + round) % MAX_PAGES;
+            char *addr = REGION_ADDR(i);
+            if (new_pages(addr, pages * PAGE_SIZE) < 0)
+            {
+                printf("frame_churn: new_pages failed in round %d\n", round);
+                exit(-1);
+            }
+            for (j = 0; j < pages; ++j)
+                addr[j * PAGE_SIZE] = (char)j;
+            frames += pages;
+        }
+        /* 5 is coprime to REGIONS, so this visits every region once */
+        for (i = 0; i < REGIONS; ++i)
+        {
+            int victim = (i * 5 + round) % REGIONS;
+            if (remove_pages(REGION_ADDR(victim)) < 0)
+            {
+                printf("frame_churn: remove_pages failed in round %d\n",
+                       round);
+                exit(-1);
+            }
+        }
+    }
+    unsigned int ticks = get_ticks() - start;
+    unsigned int end_hits, end_misses;
+    get_zero_pool_stats(&end_hits, &end_misses);
+
+    printf("frame_churn: %d rounds, %d frames in %u ticks\n",
+           rounds, frames, ticks);
+    printf("frame_churn: %u zeroed frames from the pool, %u zeroed inline\n",
+           end_hits - hits, end_misses - misses);
+    exit(0);
+}
@@ -0,0 +1,81 @@
+/** @file mutex_contend.c
+ *
+ *  @brief Microbenchmark for contended libthread mutexes
+ *
+ *  A number of threads take the same mutex over and over and do a bit
+ *  of work while holding it, so that the timer often preempts a holder
+ *  and the others find the mutex taken. The number of ticks spent is
+ *  reported at the end, together with a check that no increment of the
+ *  shared counter was lost. agility_drill and juggle are the heavier
+ *  contention tests to run next to it.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#include <syscall.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread.h>
+#include <mutex.h>
+
+#define THREADS     8
+#define ROUNDS      2000
+#define WORK        200
+#define STACK_SIZE  4096
+
+static mutex_t lock;
+static volatile int counter;
+
+/** @brief Take the mutex rounds times, working inside the critical
+ *         section
+ *
+ *  @param arg unused
+ *  @return NULL
+ */
+static void *contend(void *arg)
+{
+    int i, j;
+    for (i = 0; i < ROUNDS; ++i)
+    {
+        mutex_lock(&lock);
+        for (j = 0; j < WORK; ++j)
+            counter++;
+        mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+int main()
+{
+    int tids[THREADS];
+    int i;
+
+    thr_init(STACK_SIZE);
+    mutex_init(&lock);
+
+    unsigned int start = get_ticks();
+    for (i = 0; i < THREADS; ++i)
+    {
+        tids[i] = thr_create(contend, NULL);
+        if (tids[i] < 0)
+        {
+            printf("mutex_contend: thr_create failed\n");
+            exit(-1);
+        }
+    }
+    for (i = 0; i < THREADS; ++i)
+        thr_join(tids[i], NULL);
+    unsigned int ticks = get_ticks() - start;
+
+    if (counter != THREADS * ROUNDS * WORK)
+    {
+        printf("mutex_contend: counter is %d, expected %d\n",
+               counter, THREADS * ROUNDS * WORK);
+        exit(-1);
+    }
+    printf("mutex_contend: %d threads, %d rounds in %u ticks\n",
+           THREADS, ROUNDS, ticks);
+    exit(0);
+}
@@ -0,0 +1,110 @@
+/** @file rwlock_readers.c
+ *
+ *  @brief Microbenchmark for libthread reader writer locks under a
+ *         read-heavy load
+ *
+ *  Each thread takes the lock rounds times, as a writer once every
+ *  WRITE_EVERY times and as a reader otherwise, and looks at a shared
+ *  table while holding it. The run is repeated with 1, 2, 4 and 8
+ *  threads and the ticks of each run are reported, so the cost per
+ *  acquire can be compared as readers are added. A reader that sees
+ *  the table in the middle of an update fails the run.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#include <syscall.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread.h>
+#include <rwlock.h>
+
+#define MAX_THREADS 8
+#define ROUNDS      5000
+#define WRITE_EVERY 64
+#define TABLE_SIZE  16
+#define STACK_SIZE  4096
+
+static rwlock_t lock;
+static volatile int table[TABLE_SIZE];
+static volatile int torn;
+
+/** @brief Read or update the table rounds times
+ *
+ *  @param arg the index of the thread, to spread the writes
+ *  @return NULL
+ */
+static void *worker(void *arg)
+{
+    int i, j;
+    for (i = 0; i < ROUNDS; ++i)
+    {
+        if ((i + (int)arg) % WRITE_EVERY == 0)
+        {
+            rwlock_lock(&lock, RWLOCK_WRITE);
+            for (j = 0; j < TABLE_SIZE; ++j)
+                table[j]++;
+            rwlock_unlock(&lock);
+        }
+        else
+        {
+            rwlock_lock(&lock, RWLOCK_READ);
+            for (j = 1; j < TABLE_SIZE; ++j)
+            {
+                if (table[j] != table[0])
+                    torn = 1;
+            }
+            rwlock_unlock(&lock);
+        }
+    }
+    return NULL;
+}
+
+/** @brief Run the workers with a number of threads
+ *
+ *  @param threads the number of threads
+ *  @return the ticks the run took
+ */
+static unsigned int run(int threads)
+{
+    int tids[MAX_THREADS];
+    int i;
+
+    unsigned int start = get_ticks();
+    for (i = 0; i < threads; ++i)
+    {
+        tids[i] = thr_create(worker, (void *)i);
+        if (tids[i] < 0)
+        {
+            printf("rwlock_readers: thr_create failed\n");
+            exit(-1);
+        }
+    }
+    for (i = 0; i < threads; ++i)
+        thr_join(tids[i], NULL);
+    return get_ticks() - start;
+}
+
+int main()
+{
+    int threads;
+
+    thr_init(STACK_SIZE);
+    rwlock_init(&lock);
+
+    for (threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        unsigned int ticks = run(threads);
+        if (torn)
+        {
+            printf("rwlock_readers: a reader saw a partial update\n");
+            exit(-1);
+        }
+        printf("rwlock_readers: %d threads, %d rounds each in %u ticks\n",
+               threads, ROUNDS, ticks);
+    }
+    rwlock_destroy(&lock);
+    exit(0);
+}
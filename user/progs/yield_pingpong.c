@@ -0,0 +1,91 @@
+/** @file yield_pingpong.c
+ *
+ *  @brief Microbenchmark for context switches
+ *
+ *  Two threads hand the CPU back and forth with yield(tid), first two
+ *  threads of the same process and then a parent and its forked child.
+ *  Switches between sibling threads keep the page directory, so the
+ *  first phase should take noticeably fewer ticks than the second. The
+ *  kernel prints how many switches of each kind it did when it halts.
+ *
+ *  @author Xianqi Zeng (xianqiz)
+ *  @author Tianyuan Ding (tding)
+ *  @bug No known bugs
+ */
+
+#include <syscall.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread.h>
+
+#define ROUNDS      10000
+#define STACK_SIZE  4096
+
+static volatile int main_tid;
+
+/** @brief Yield to a peer thread until it is gone or we are done
+ *
+ *  @param peer the tid of the other thread
+ *  @return void
+ */
+static void ping_pong(int peer)
+{
+    int i;
+    for (i = 0; i < ROUNDS; ++i)
+    {
+        if (yield(peer) < 0)
+            break;
+    }
+}
+
+/** @brief The sibling thread of the first phase
+ *
+ *  @param arg unused
+ *  @return NULL
+ */
+static void *sibling(void *arg)
+{
+    ping_pong(main_tid);
+    return NULL;
+}
+
+int main()
+{
+    int status;
+
+    thr_init(STACK_SIZE);
+    main_tid = thr_getid();
+
+    unsigned int start = get_ticks();
+    int tid = thr_create(sibling, NULL);
+    if (tid < 0)
+    {
+        printf("yield_pingpong: thr_create failed\n");
+        exit(-1);
+    }
+    ping_pong(tid);
+    thr_join(tid, NULL);
+    unsigned int thread_ticks = get_ticks() - start;
+
+    int parent = gettid();
+    start = get_ticks();
+    int child = fork();
+    if (child < 0)
+    {
+        printf("yield_pingpong: fork failed\n");
+        exit(-1);
+    }
+    if (child == 0)
+    {
+        ping_pong(parent);
+        exit(0);
+    }
+    ping_pong(child);
+    wait(&status);
+    unsigned int process_ticks = get_ticks() - start;
+
+    printf("yield_pingpong: %d rounds, %u ticks between threads, "
+           "%u ticks between processes\n", ROUNDS, thread_ticks,
+           process_ticks);
+    exit(0);
+}